@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2020 Oleg Dolgy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Benchmark for Software TWI module
+ *
+ * The driver runs against counting no-op pin callbacks, so only the driver overhead is
+ * measured. Usage: bench [csv|json]
+ *
+ */
+
+#include "stwi.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*------------------------------------------------------------------------------------------------*/
+/* Counting no-op backend */
+/*------------------------------------------------------------------------------------------------*/
+/* Slave behavior */
+struct scenario
+{
+    char const *name;
+    /* Every N-th read of SCL returns low (clock stretch), zero disables stretching */
+    unsigned stretch_every;
+    /* SDA is never pulled low, so every byte is not acknowledged */
+    bool nack;
+};
+
+static struct scenario const *scenario;
+static unsigned long long pin_calls, delay_calls;
+static unsigned scl_reads;
+
+static void write_pin(struct stwi const *bus, stwi_pin_state_t state)
+{
+    pin_calls++;
+}
+
+static stwi_pin_state_t read_scl(struct stwi const *bus)
+{
+    pin_calls++;
+    scl_reads++;
+    return (scenario->stretch_every && scl_reads % scenario->stretch_every == 0) ? STWI_PIN_LOW : STWI_PIN_HIGH;
+}
+
+static stwi_pin_state_t read_sda(struct stwi const *bus)
+{
+    pin_calls++;
+    return scenario->nack ? STWI_PIN_HIGH : STWI_PIN_LOW;
+}
+
+static void delay(struct stwi const *bus)
+{
+    delay_calls++;
+}
+
+static void timeout_start(struct stwi const *bus)
+{
+}
+
+static bool timeout_check(struct stwi const *bus)
+{
+    return true;
+}
+
+static struct stwi const stwi = {
+    .write_scl = write_pin,
+    .write_sda = write_pin,
+    .read_scl = read_scl,
+    .read_sda = read_sda,
+    .delay = delay,
+    .timeout_start = timeout_start,
+    .timeout_check = timeout_check,
+};
+/*------------------------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------------------------*/
+/* Benchmark */
+/*------------------------------------------------------------------------------------------------*/
+/* Result of one run */
+struct result
+{
+    char const *op;
+    char const *scenario;
+    int reg_bits;
+    size_t size;
+    /* Per transaction */
+    unsigned long long pin_calls;
+    unsigned long long delay_calls;
+    double ns;
+    /* Per transferred byte (per transaction if nothing is transferred) */
+    double ns_per_byte;
+};
+
+static uint8_t buff[65536];
+
+/* CPU time of the thread, so time of other processes is not counted */
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Run transactions of the same kind */
+static struct result run(bool read, stwi_reg_size_t reg_size, size_t size, struct scenario const *sc)
+{
+    /* About 256 KiB of data, but at least several transactions */
+    size_t reps = (size < (1 << 18) / 4) ? (1 << 18) / size : 4;
+    scenario = sc;
+    pin_calls = 0;
+    delay_calls = 0;
+    scl_reads = 0;
+    size_t bytes = 0;
+    double start = now_ns();
+    for (size_t i = 0; i < reps; i++)
+    {
+        struct stwi_res res = read ? stwi_dev_read(&stwi, 0x25, reg_size, 0x1234, buff, size) :
+                                     stwi_dev_write(&stwi, 0x25, reg_size, 0x1234, buff, size);
+        bytes += res.data_size;
+    }
+    double ns = now_ns() - start;
+    return (struct result){
+        .op = read ? "read" : "write",
+        .scenario = sc->name,
+        .reg_bits = (reg_size == STWI_REG_16) ? 16 : (reg_size == STWI_REG_8) ? 8 : 0,
+        .size = size,
+        .pin_calls = pin_calls / reps,
+        .delay_calls = delay_calls / reps,
+        .ns = ns / reps,
+        .ns_per_byte = bytes ? ns / bytes : ns / reps,
+    };
+}
+
+static void print(struct result const *r, bool json, bool first)
+{
+    if (json)
+    {
+        printf("%s\n  {\"op\": \"%s\", \"scenario\": \"%s\", \"reg_bits\": %d, \"size\": %zu, "
+               "\"pin_calls\": %llu, \"delay_calls\": %llu, \"ns\": %.1f, \"ns_per_byte\": %.2f}",
+               first ? "" : ",", r->op, r->scenario, r->reg_bits, r->size,
+               r->pin_calls, r->delay_calls, r->ns, r->ns_per_byte);
+    }
+    else
+    {
+        printf("%s,%s,%d,%zu,%llu,%llu,%.1f,%.2f\n", r->op, r->scenario, r->reg_bits, r->size,
+               r->pin_calls, r->delay_calls, r->ns, r->ns_per_byte);
+    }
+}
+/*------------------------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------------------------*/
+int main(int argc, char **argv)
+{
+    static struct scenario const scenarios[] = {
+        {.name = "ack"},
+        {.name = "stretch", .stretch_every = 9},
+        {.name = "nack", .nack = true},
+    };
+    static size_t const sizes[] = {1, 16, 256, 4096, 65536};
+    static stwi_reg_size_t const reg_sizes[] = {STWI_REG_0, STWI_REG_8, STWI_REG_16};
+    bool json = argc > 1 && !strcmp(argv[1], "json");
+    bool first = true;
+
+    if (json) { printf("["); }
+    else { printf("op,scenario,reg_bits,size,pin_calls,delay_calls,ns,ns_per_byte\n"); }
+    for (size_t s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++)
+    {
+        for (int read = 0; read < 2; read++)
+        {
+            for (size_t r = 0; r < sizeof(reg_sizes) / sizeof(reg_sizes[0]); r++)
+            {
+                for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+                {
+                    /* Failed transactions don't depend on data size */
+                    if (scenarios[s].nack && i) { break; }
+                    struct result res = run(read, reg_sizes[r], sizes[i], &scenarios[s]);
+                    print(&res, json, first);
+                    first = false;
+                }
+            }
+        }
+    }
+    if (json) { printf("\n]\n"); }
+    return EXIT_SUCCESS;
+}
+/*------------------------------------------------------------------------------------------------*/
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2020 Oleg Dolgy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Bus manager: a worker thread per bus shared by many threads (POSIX).
+ *
+ */
+
+#include "stwi_mgr.h"
+
+/* Take the next submitted request, NULL if the ring is empty */
+static struct stwi_mgr_req *stwi_mgr_take(struct stwi_mgr *mgr)
+{
+    struct stwi_mgr_slot *slot = &mgr->slots[mgr->head & mgr->mask];
+    STWI_ASSERT(atomic_load_explicit(&slot->seq, memory_order_acquire) == mgr->head + 1, return NULL;);
+    struct stwi_mgr_req *req = slot->req;
+    /* Free the slot for the submission one ring later */
+    atomic_store_explicit(&slot->seq, mgr->head + mgr->mask + 1, memory_order_release);
+    mgr->head++;
+    return req;
+}
+
+/* Perform request and notify about its completion */
+static void stwi_mgr_perform(struct stwi_mgr *mgr, struct stwi_mgr_req *req)
+{
+    req->res = stwi_transfer(mgr->bus, req->msgs, req->count);
+    /* Waiters return after the callback */
+    if (req->done) { req->done(req); }
+    atomic_store(&req->complete, true);
+    /* Waiters count is checked after the flag, the mutex is taken only if there are waiters */
+    STWI_ASSERT(atomic_load(&mgr->waiters), return;);
+    pthread_mutex_lock(&mgr->lock);
+    pthread_cond_broadcast(&mgr->completed);
+    pthread_mutex_unlock(&mgr->lock);
+}
+
+static void *stwi_mgr_worker(void *arg)
+{
+    struct stwi_mgr *mgr = arg;
+    for (;;)
+    {
+        /* Drain all submitted requests */
+        struct stwi_mgr_req *req;
+        while ((req = stwi_mgr_take(mgr)))
+        {
+            stwi_mgr_perform(mgr, req);
+        }
+        /* Announce sleeping before the last check of the ring, submitters check it after publishing */
+        atomic_store(&mgr->sleeping, true);
+        atomic_thread_fence(memory_order_seq_cst);
+        if ((req = stwi_mgr_take(mgr)))
+        {
+            atomic_store(&mgr->sleeping, false);
+            stwi_mgr_perform(mgr, req);
+            continue;
+        }
+        if (atomic_load(&mgr->stop)) { break; }
+        pthread_mutex_lock(&mgr->lock);
+        while (atomic_load(&mgr->sleeping) && !atomic_load(&mgr->stop))
+        {
+            pthread_cond_wait(&mgr->submitted, &mgr->lock);
+        }
+        pthread_mutex_unlock(&mgr->lock);
+        atomic_fetch_add(&mgr->wakeups, 1);
+    }
+    return NULL;
+}
+
+/* Wake worker thread up if it is sleeping */
+static void stwi_mgr_wake(struct stwi_mgr *mgr)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    STWI_ASSERT(atomic_exchange(&mgr->sleeping, false), return;);
+    pthread_mutex_lock(&mgr->lock);
+    pthread_cond_signal(&mgr->submitted);
+    pthread_mutex_unlock(&mgr->lock);
+}
+
+bool stwi_mgr_start(struct stwi_mgr *mgr, struct stwi const *bus, struct stwi_mgr_slot *slots, size_t size)
+{
+    STWI_ASSERT(size && !(size & (size - 1)), return false;);
+    *mgr = (struct stwi_mgr){
+        .bus = bus,
+        .slots = slots,
+        .mask = size - 1,
+    };
+    for (size_t i = 0; i < size; i++)
+    {
+        atomic_init(&slots[i].seq, i);
+    }
+    pthread_mutex_init(&mgr->lock, NULL);
+    pthread_cond_init(&mgr->submitted, NULL);
+    pthread_cond_init(&mgr->completed, NULL);
+    if (!pthread_create(&mgr->worker, NULL, stwi_mgr_worker, mgr)) { return true; }
+    pthread_cond_destroy(&mgr->completed);
+    pthread_cond_destroy(&mgr->submitted);
+    pthread_mutex_destroy(&mgr->lock);
+    return false;
+}
+
+void stwi_mgr_stop(struct stwi_mgr *mgr)
+{
+    atomic_store(&mgr->stop, true);
+    pthread_mutex_lock(&mgr->lock);
+    pthread_cond_signal(&mgr->submitted);
+    pthread_mutex_unlock(&mgr->lock);
+    pthread_join(mgr->worker, NULL);
+    pthread_cond_destroy(&mgr->completed);
+    pthread_cond_destroy(&mgr->submitted);
+    pthread_mutex_destroy(&mgr->lock);
+}
+
+bool stwi_mgr_submit(struct stwi_mgr *mgr, struct stwi_mgr_req *reqs, size_t count)
+{
+    STWI_ASSERT(count && count <= mgr->mask + 1, return false;);
+    /* Reserve consecutive slots: they are freed in order, so the last one being free is enough */
+    size_t tail = atomic_load_explicit(&mgr->tail, memory_order_relaxed);
+    do
+    {
+        size_t seq = atomic_load_explicit(&mgr->slots[(tail + count - 1) & mgr->mask].seq, memory_order_acquire);
+        STWI_ASSERT((ptrdiff_t)(seq - (tail + count - 1)) >= 0, return false;);
+    } while (!atomic_compare_exchange_weak(&mgr->tail, &tail, tail + count));
+    /* Fill and publish slots */
+    for (size_t i = 0; i < count; i++)
+    {
+        struct stwi_mgr_slot *slot = &mgr->slots[(tail + i) & mgr->mask];
+        atomic_store_explicit(&reqs[i].complete, false, memory_order_relaxed);
+        slot->req = &reqs[i];
+        atomic_store_explicit(&slot->seq, tail + i + 1, memory_order_release);
+    }
+    stwi_mgr_wake(mgr);
+    return true;
+}
+
+void stwi_mgr_wait(struct stwi_mgr *mgr, struct stwi_mgr_req *req)
+{
+    STWI_ASSERT(!atomic_load(&req->complete), return;);
+    atomic_fetch_add(&mgr->waiters, 1);
+    pthread_mutex_lock(&mgr->lock);
+    while (!atomic_load(&req->complete))
+    {
+        pthread_cond_wait(&mgr->completed, &mgr->lock);
+    }
+    pthread_mutex_unlock(&mgr->lock);
+    atomic_fetch_sub(&mgr->waiters, 1);
+}
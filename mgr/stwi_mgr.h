@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2020 Oleg Dolgy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Bus manager: a worker thread per bus shared by many threads (POSIX).
+ *
+ * Client threads submit requests into a lock-free ring with many producers and the worker
+ * of the bus as the only consumer. The worker performs requests in the order of submission
+ * with stwi_transfer() and drains all submitted requests per wakeup, so a batch submitted
+ * at once costs one wakeup. Completion is reported through the callback of the request
+ * and can be waited for or polled like a future:
+ *
+ *     stwi_mgr_start(&mgr, &bus, slots, 64);
+ *     ...
+ *     stwi_mgr_submit(&mgr, &req, 1);
+ *     stwi_mgr_wait(&mgr, &req);
+ *     ...
+ *     stwi_mgr_stop(&mgr);
+ *
+ * The bus must not be used directly while the manager is running.
+ *
+ */
+
+#ifndef SOFTBUS_STWI_MGR_H
+#define SOFTBUS_STWI_MGR_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include "stwi.h"
+
+/* Transfer request */
+struct stwi_mgr_req
+{
+    /* Messages of the transfer */
+    struct stwi_msg *msgs;
+    size_t count;
+    /* Optional: the request is done, called by the worker thread */
+    void (*done)(struct stwi_mgr_req *req);
+    /* User context */
+    void *ctx;
+    /* Result of the transfer, valid after completion */
+    struct stwi_res res;
+    /* Completion flag, cleared on submission */
+    atomic_bool complete;
+};
+
+/* Slot of the submission ring */
+struct stwi_mgr_slot
+{
+    /* Position the slot is ready for: to be filled at 'seq', to be taken at 'seq' - 1 */
+    atomic_size_t seq;
+    struct stwi_mgr_req *req;
+};
+
+/* Bus manager */
+struct stwi_mgr
+{
+    struct stwi const *bus;
+    /* Submission ring, its size is a power of two */
+    struct stwi_mgr_slot *slots;
+    size_t mask;
+    /* Positions of the next submission and of the next request to be performed */
+    atomic_size_t tail;
+    size_t head;
+    /* Worker thread is waiting for submissions or is asked to stop */
+    atomic_bool sleeping;
+    atomic_bool stop;
+    /* Number of threads waiting for completion */
+    atomic_uint waiters;
+    /* Number of worker wakeups */
+    atomic_uint wakeups;
+    pthread_mutex_t lock;
+    pthread_cond_t submitted;
+    pthread_cond_t completed;
+    pthread_t worker;
+};
+
+/* Start worker thread of the bus with the submission ring of 'size' slots (a power of two).
+ * Returns false if the size is invalid or the thread can't be created. */
+bool stwi_mgr_start(struct stwi_mgr *mgr, struct stwi const *bus, struct stwi_mgr_slot *slots, size_t size);
+
+/* Perform submitted requests and stop worker thread */
+void stwi_mgr_stop(struct stwi_mgr *mgr);
+
+/* Submit 'count' requests to be performed back-to-back in the order of the array, safe to call
+ * from any thread. Returns false if the ring doesn't have enough free slots, nothing is submitted. */
+bool stwi_mgr_submit(struct stwi_mgr *mgr, struct stwi_mgr_req *reqs, size_t count);
+
+/* Wait for completion of a submitted request */
+void stwi_mgr_wait(struct stwi_mgr *mgr, struct stwi_mgr_req *req);
+
+/* Check whether a submitted request is complete */
+static inline bool stwi_mgr_done(struct stwi_mgr_req *req)
+{
+    return atomic_load(&req->complete);
+}
+
+#endif /* SOFTBUS_STWI_MGR_H */
@@ -0,0 +1,405 @@
+/*
+ * Copyright (c) 2020 Oleg Dolgy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Simulated Two Wire Interface bus with behavioral slave devices.
+ *
+ */
+
+#include "stwi_sim.h"
+
+#include <limits.h>
+#include <string.h>
+
+/* Get simulator by bus handle */
+static struct stwi_sim *stwi_sim_get(struct stwi const *bus)
+{
+    return (struct stwi_sim *)bus;
+}
+
+/* Select device by address byte */
+static bool stwi_sim_select(struct stwi_sim *sim, uint8_t byte)
+{
+    uint8_t addr = byte >> 1;
+    sim->dir = (byte & 0x01) ? STWI_DIR_READ : STWI_DIR_WRITE;
+    for (struct stwi_sim_dev *dev = sim->devs; dev; dev = dev->next)
+    {
+        if ((addr & ~dev->addr_mask) == dev->addr && dev->min_high <= sim->high_min &&
+            dev->start(dev, addr, sim->dir))
+        {
+            sim->dev = dev;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Handle SCL falling edge: the slave changes SDA while SCL is low */
+static void stwi_sim_scl_fall(struct stwi_sim *sim)
+{
+    struct stwi_sim_dev *dev = sim->dev;
+    unsigned high = (unsigned)(sim->time - sim->rise_time);
+    if (high < sim->high_min) { sim->high_min = high; }
+    if (sim->mode == STWI_SIM_RX && sim->bits == 8)
+    {
+        /* Byte is received, answer with ACK or NACK */
+        bool ack = sim->addr_phase ? stwi_sim_select(sim, sim->shift) :
+                                     (dev->min_high <= sim->high_min && dev->write(dev, sim->shift));
+        sim->slave_sda = ack ? STWI_PIN_LOW : STWI_PIN_HIGH;
+        if (ack) { sim->acks++; }
+        else
+        {
+            sim->nacks++;
+            sim->mode = STWI_SIM_IDLE;
+        }
+        return;
+    }
+    if (sim->mode == STWI_SIM_RX && sim->bits == 9)
+    {
+        /* ACK bit is over */
+        sim->slave_sda = STWI_PIN_HIGH;
+        sim->stretch_left = sim->dev->stretch_byte;
+        sim->bits = 0;
+        sim->high_min = UINT_MAX;
+        if (sim->addr_phase && sim->dir == STWI_DIR_READ)
+        {
+            sim->mode = STWI_SIM_TX;
+            sim->shift = sim->dev->read(sim->dev);
+            sim->slave_sda = (sim->shift & 0x80) ? STWI_PIN_HIGH : STWI_PIN_LOW;
+        }
+        sim->addr_phase = false;
+        return;
+    }
+    if (sim->mode == STWI_SIM_TX && sim->bits == 9)
+    {
+        /* Master has acknowledged the byte or finished reading */
+        sim->bits = 0;
+        if (sim->master_ack)
+        {
+            sim->stretch_left = dev->stretch_byte;
+            sim->shift = dev->read(dev);
+            sim->slave_sda = (sim->shift & 0x80) ? STWI_PIN_HIGH : STWI_PIN_LOW;
+        }
+        else
+        {
+            sim->mode = STWI_SIM_IDLE;
+            sim->slave_sda = STWI_PIN_HIGH;
+        }
+        return;
+    }
+    if (sim->mode == STWI_SIM_TX)
+    {
+        /* Next data bit or released SDA for ACK bit of the master, a missed clock pulse keeps
+         * the previous data bit */
+        bool level = (sim->bits == 8) || (sim->shift << sim->bits & 0x80);
+        if (sim->bits == 8 || high >= dev->min_high) { sim->slave_sda = level ? STWI_PIN_HIGH : STWI_PIN_LOW; }
+    }
+    if (sim->mode != STWI_SIM_IDLE && dev) { sim->stretch_left = dev->stretch_bit; }
+}
+
+/* Handle SCL rising edge: the receiver samples SDA */
+static void stwi_sim_scl_rise(struct stwi_sim *sim)
+{
+    sim->rise_time = sim->time;
+    if (sim->mode == STWI_SIM_RX && sim->bits < 8)
+    {
+        sim->shift = sim->shift << 1 | (sim->sda == STWI_PIN_HIGH ? 0x01 : 0x00);
+    }
+    if (sim->mode == STWI_SIM_TX && sim->bits == 8)
+    {
+        sim->master_ack = (sim->sda == STWI_PIN_LOW);
+    }
+    if (sim->mode != STWI_SIM_IDLE) { sim->bits++; }
+}
+
+/* Update line states and handle their changes */
+static void stwi_sim_update(struct stwi_sim *sim)
+{
+    stwi_pin_state_t scl = (sim->scl_out == STWI_PIN_HIGH && !sim->stretch_left) ? STWI_PIN_HIGH : STWI_PIN_LOW;
+    stwi_pin_state_t sda = (sim->sda_out == STWI_PIN_HIGH && sim->slave_sda == STWI_PIN_HIGH) ?
+                               STWI_PIN_HIGH :
+                               STWI_PIN_LOW;
+    stwi_pin_state_t scl_prev = sim->scl, sda_prev = sim->sda;
+    sim->scl = scl;
+    sim->sda = sda;
+    if (scl == STWI_PIN_HIGH && scl_prev == STWI_PIN_HIGH && sda != sda_prev)
+    {
+        if (sda == STWI_PIN_LOW)
+        {
+            /* Start or repeated start condition */
+            sim->mode = STWI_SIM_RX;
+            sim->addr_phase = true;
+            sim->bits = 0;
+            sim->high_min = UINT_MAX;
+            sim->dev = NULL;
+        }
+        else
+        {
+            /* Stop condition */
+            if (sim->dev && sim->dev->stop) { sim->dev->stop(sim->dev); }
+            sim->mode = STWI_SIM_IDLE;
+            sim->dev = NULL;
+        }
+        sim->slave_sda = STWI_PIN_HIGH;
+    }
+    else if (scl != scl_prev)
+    {
+        if (scl == STWI_PIN_HIGH) { stwi_sim_scl_rise(sim); }
+        else { stwi_sim_scl_fall(sim); }
+        /* SDA of the slave may have been changed */
+        sim->sda = (sim->sda_out == STWI_PIN_HIGH && sim->slave_sda == STWI_PIN_HIGH) ? STWI_PIN_HIGH : STWI_PIN_LOW;
+    }
+}
+
+static void stwi_sim_write_scl(struct stwi const *bus, stwi_pin_state_t state)
+{
+    struct stwi_sim *sim = stwi_sim_get(bus);
+    sim->pin_calls++;
+    sim->scl_out = state;
+    stwi_sim_update(sim);
+}
+
+static void stwi_sim_write_sda(struct stwi const *bus, stwi_pin_state_t state)
+{
+    struct stwi_sim *sim = stwi_sim_get(bus);
+    sim->pin_calls++;
+    sim->sda_out = state;
+    stwi_sim_update(sim);
+}
+
+static stwi_pin_state_t stwi_sim_read_scl(struct stwi const *bus)
+{
+    struct stwi_sim *sim = stwi_sim_get(bus);
+    sim->pin_calls++;
+    return sim->scl;
+}
+
+static stwi_pin_state_t stwi_sim_read_sda(struct stwi const *bus)
+{
+    struct stwi_sim *sim = stwi_sim_get(bus);
+    sim->pin_calls++;
+    return sim->sda;
+}
+
+static void stwi_sim_delay(struct stwi const *bus)
+{
+    struct stwi_sim *sim = stwi_sim_get(bus);
+    sim->time++;
+    if (sim->timeout) { sim->timeout--; }
+    if (sim->stretch_left) { sim->stretch_left--; }
+    for (struct stwi_sim_dev *dev = sim->devs; dev; dev = dev->next)
+    {
+        if (dev->tick) { dev->tick(dev); }
+    }
+    stwi_sim_update(sim);
+}
+
+static void stwi_sim_timeout_start(struct stwi const *bus)
+{
+    struct stwi_sim *sim = stwi_sim_get(bus);
+    sim->timeout = sim->stretch_timeout;
+}
+
+static bool stwi_sim_timeout_check(struct stwi const *bus)
+{
+    return stwi_sim_get(bus)->timeout > 0;
+}
+
+void stwi_sim_init(struct stwi_sim *sim)
+{
+    *sim = (struct stwi_sim){
+        .bus = {
+            .write_scl = stwi_sim_write_scl,
+            .write_sda = stwi_sim_write_sda,
+            .read_scl = stwi_sim_read_scl,
+            .read_sda = stwi_sim_read_sda,
+            .delay = stwi_sim_delay,
+            .timeout_start = stwi_sim_timeout_start,
+            .timeout_check = stwi_sim_timeout_check,
+        },
+        .stretch_timeout = 1000,
+        .scl_out = STWI_PIN_HIGH,
+        .sda_out = STWI_PIN_HIGH,
+        .scl = STWI_PIN_HIGH,
+        .sda = STWI_PIN_HIGH,
+        .slave_sda = STWI_PIN_HIGH,
+        .high_min = UINT_MAX,
+    };
+}
+
+void stwi_sim_attach(struct stwi_sim *sim, struct stwi_sim_dev *dev)
+{
+    dev->next = sim->devs;
+    sim->devs = dev;
+}
+
+/*------------------------------------------------------------------------------------------------*/
+/* Register map device */
+/*------------------------------------------------------------------------------------------------*/
+/* Number of register address bytes */
+static uint8_t stwi_sim_reg_bytes(stwi_reg_size_t reg_size)
+{
+    return (reg_size == STWI_REG_16) ? 2 : (reg_size == STWI_REG_8) ? 1 : 0;
+}
+
+static bool stwi_sim_regs_start(struct stwi_sim_dev *dev, uint8_t addr, stwi_dir_t dir)
+{
+    struct stwi_sim_regs *regs = (struct stwi_sim_regs *)dev;
+    if (dir == STWI_DIR_WRITE) { regs->reg_left = stwi_sim_reg_bytes(regs->reg_size); }
+    return true;
+}
+
+static bool stwi_sim_regs_write(struct stwi_sim_dev *dev, uint8_t byte)
+{
+    struct stwi_sim_regs *regs = (struct stwi_sim_regs *)dev;
+    if (regs->reg_left)
+    {
+        regs->ptr = (regs->reg_left == stwi_sim_reg_bytes(regs->reg_size)) ? byte : (regs->ptr << 8 | byte);
+        regs->reg_left--;
+        return true;
+    }
+    regs->regs[regs->ptr++ % regs->size] = byte;
+    return true;
+}
+
+static uint8_t stwi_sim_regs_read(struct stwi_sim_dev *dev)
+{
+    struct stwi_sim_regs *regs = (struct stwi_sim_regs *)dev;
+    return regs->regs[regs->ptr++ % regs->size];
+}
+
+void stwi_sim_regs_init(struct stwi_sim_regs *regs,
+                        uint8_t addr,
+                        stwi_reg_size_t reg_size,
+                        uint8_t *data,
+                        size_t size)
+{
+    *regs = (struct stwi_sim_regs){
+        .dev = {
+            .addr = addr,
+            .start = stwi_sim_regs_start,
+            .write = stwi_sim_regs_write,
+            .read = stwi_sim_regs_read,
+        },
+        .reg_size = reg_size,
+        .regs = data,
+        .size = size,
+    };
+}
+/*------------------------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------------------------*/
+/* EEPROM */
+/*------------------------------------------------------------------------------------------------*/
+/* Get start of the page */
+static size_t stwi_sim_eeprom_page(struct stwi_sim_eeprom const *eeprom)
+{
+    return (eeprom->ptr % eeprom->size) / eeprom->page_size * eeprom->page_size;
+}
+
+static bool stwi_sim_eeprom_start(struct stwi_sim_dev *dev, uint8_t addr, stwi_dir_t dir)
+{
+    struct stwi_sim_eeprom *eeprom = (struct stwi_sim_eeprom *)dev;
+    if (eeprom->busy) { return false; }
+    if (dir == STWI_DIR_WRITE)
+    {
+        eeprom->reg_left = stwi_sim_reg_bytes(eeprom->reg_size);
+        /* Block bits of the device address */
+        eeprom->ptr = (addr & dev->addr_mask) << 8;
+    }
+    return true;
+}
+
+static bool stwi_sim_eeprom_write(struct stwi_sim_dev *dev, uint8_t byte)
+{
+    struct stwi_sim_eeprom *eeprom = (struct stwi_sim_eeprom *)dev;
+    if (eeprom->reg_left)
+    {
+        eeprom->ptr = (eeprom->reg_left == 1) ? ((eeprom->ptr & 0xFF00) | byte) : (byte << 8);
+        eeprom->reg_left--;
+        if (!eeprom->reg_left)
+        {
+            /* Load page buffer */
+            memcpy(eeprom->page, &eeprom->mem[stwi_sim_eeprom_page(eeprom)], eeprom->page_size);
+        }
+        return true;
+    }
+    /* Address wraps around within the page */
+    size_t offs = eeprom->ptr % eeprom->page_size;
+    eeprom->page[offs] = byte;
+    eeprom->ptr = stwi_sim_eeprom_page(eeprom) + (offs + 1) % eeprom->page_size;
+    eeprom->dirty = true;
+    return true;
+}
+
+static uint8_t stwi_sim_eeprom_read(struct stwi_sim_dev *dev)
+{
+    struct stwi_sim_eeprom *eeprom = (struct stwi_sim_eeprom *)dev;
+    uint8_t byte = eeprom->mem[eeprom->ptr % eeprom->size];
+    eeprom->ptr = (eeprom->ptr + 1) % eeprom->size;
+    return byte;
+}
+
+static void stwi_sim_eeprom_stop(struct stwi_sim_dev *dev)
+{
+    struct stwi_sim_eeprom *eeprom = (struct stwi_sim_eeprom *)dev;
+    if (eeprom->dirty)
+    {
+        /* Program the page */
+        memcpy(&eeprom->mem[stwi_sim_eeprom_page(eeprom)], eeprom->page, eeprom->page_size);
+        eeprom->busy = eeprom->write_time;
+        eeprom->dirty = false;
+        eeprom->pages_written++;
+    }
+}
+
+static void stwi_sim_eeprom_tick(struct stwi_sim_dev *dev)
+{
+    struct stwi_sim_eeprom *eeprom = (struct stwi_sim_eeprom *)dev;
+    if (eeprom->busy) { eeprom->busy--; }
+}
+
+void stwi_sim_eeprom_init(struct stwi_sim_eeprom *eeprom,
+                          uint8_t addr,
+                          stwi_reg_size_t reg_size,
+                          uint8_t *mem,
+                          size_t size,
+                          uint16_t page_size,
+                          unsigned write_time)
+{
+    uint8_t blocks = (reg_size == STWI_REG_8 && size > 256) ? (size - 1) >> 8 : 0;
+    *eeprom = (struct stwi_sim_eeprom){
+        .dev = {
+            .addr = addr,
+            .addr_mask = blocks,
+            .start = stwi_sim_eeprom_start,
+            .write = stwi_sim_eeprom_write,
+            .read = stwi_sim_eeprom_read,
+            .stop = stwi_sim_eeprom_stop,
+            .tick = stwi_sim_eeprom_tick,
+        },
+        .reg_size = reg_size,
+        .mem = mem,
+        .size = size,
+        .page_size = page_size,
+        .write_time = write_time,
+    };
+}
+/*------------------------------------------------------------------------------------------------*/
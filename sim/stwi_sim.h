@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2020 Oleg Dolgy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Simulated Two Wire Interface bus with behavioral slave devices.
+ *
+ * The simulator implements the callbacks of 'struct stwi': pin writes of the driver are
+ * decoded into start and stop conditions and bits, attached devices answer on byte level.
+ * One 'delay' call is one quarter period of the simulated time.
+ *
+ *     struct stwi_sim sim;
+ *     struct stwi_sim_eeprom eeprom;
+ *     stwi_sim_init(&sim);
+ *     stwi_sim_eeprom_init(&eeprom, 0x50, STWI_REG_16, mem, sizeof(mem), 64, 1000);
+ *     stwi_sim_attach(&sim, &eeprom.dev);
+ *     stwi_dev_read(&sim.bus, 0x50, STWI_REG_16, 0x0000, buff, sizeof(buff));
+ *
+ */
+
+#ifndef SOFTBUS_STWI_SIM_H
+#define SOFTBUS_STWI_SIM_H
+
+#include "stwi.h"
+
+/* Maximum page size of EEPROM */
+#define STWI_SIM_PAGE_MAX 256
+
+/* Simulated slave device */
+struct stwi_sim_dev
+{
+    /* 7-bit address */
+    uint8_t addr;
+    /* Address bits ignored by matching (e.g. EEPROM block bits) */
+    uint8_t addr_mask;
+    /* Clock stretch after the ACK bit of every byte and after other bits, in quarter periods */
+    unsigned stretch_byte;
+    unsigned stretch_bit;
+    /* Minimum SCL high time in quarter periods, the device misses shorter clock pulses:
+     * it doesn't acknowledge received bytes and doesn't change SDA for sent bits */
+    unsigned min_high;
+    /* Device is addressed with the specified 7-bit address, returns ACK */
+    bool (*start)(struct stwi_sim_dev *dev, uint8_t addr, stwi_dir_t dir);
+    /* Byte is received from the master, returns ACK */
+    bool (*write)(struct stwi_sim_dev *dev, uint8_t byte);
+    /* Get byte to be sent to the master */
+    uint8_t (*read)(struct stwi_sim_dev *dev);
+    /* Optional: stop condition is received after the device has been addressed */
+    void (*stop)(struct stwi_sim_dev *dev);
+    /* Optional: quarter period of time has passed */
+    void (*tick)(struct stwi_sim_dev *dev);
+    /* Next attached device */
+    struct stwi_sim_dev *next;
+};
+
+/* Register map device (e.g. a sensor) with register address auto-increment */
+struct stwi_sim_regs
+{
+    struct stwi_sim_dev dev;
+    stwi_reg_size_t reg_size;
+    /* Registers, the address wraps around at 'size' */
+    uint8_t *regs;
+    size_t size;
+    /* Register address pointer */
+    uint16_t ptr;
+    /* Register address bytes to be received */
+    uint8_t reg_left;
+};
+
+/* 24Cxx series EEPROM */
+struct stwi_sim_eeprom
+{
+    struct stwi_sim_dev dev;
+    stwi_reg_size_t reg_size;
+    uint8_t *mem;
+    size_t size;
+    uint16_t page_size;
+    /* Internal write cycle time in quarter periods */
+    unsigned write_time;
+    /* Remaining internal write cycle time, the device doesn't acknowledge its address */
+    unsigned busy;
+    /* Memory address pointer */
+    uint16_t ptr;
+    /* Memory address bytes to be received */
+    uint8_t reg_left;
+    /* Page buffer is written and has to be programmed on stop condition */
+    bool dirty;
+    uint8_t page[STWI_SIM_PAGE_MAX];
+    /* Number of programmed pages */
+    size_t pages_written;
+};
+
+/* Simulated bus */
+struct stwi_sim
+{
+    /* Bus handle for the driver functions, must be the first member */
+    struct stwi bus;
+    /* Attached devices */
+    struct stwi_sim_dev *devs;
+    /* Clock stretch timeout in quarter periods */
+    unsigned stretch_timeout;
+    /* Simulated time in quarter periods */
+    uint64_t time;
+    /* Number of pin callbacks */
+    uint64_t pin_calls;
+    /* Number of acknowledged and not acknowledged bytes */
+    uint64_t acks;
+    uint64_t nacks;
+    /* Internal state */
+    stwi_pin_state_t scl_out, sda_out, scl, sda, slave_sda;
+    unsigned stretch_left, timeout;
+    /* Time of the last SCL rising edge and the shortest SCL high time of the current byte */
+    uint64_t rise_time;
+    unsigned high_min;
+    struct stwi_sim_dev *dev;
+    enum
+    {
+        STWI_SIM_IDLE,
+        STWI_SIM_RX,
+        STWI_SIM_TX,
+    } mode;
+    bool addr_phase, master_ack;
+    stwi_dir_t dir;
+    uint8_t shift, bits;
+};
+
+/* Initialize simulated bus without devices */
+void stwi_sim_init(struct stwi_sim *sim);
+
+/* Attach device to the bus */
+void stwi_sim_attach(struct stwi_sim *sim, struct stwi_sim_dev *dev);
+
+/* Initialize register map device */
+void stwi_sim_regs_init(struct stwi_sim_regs *regs,
+                        uint8_t addr,
+                        stwi_reg_size_t reg_size,
+                        uint8_t *data,
+                        size_t size);
+
+/* Initialize EEPROM. For 8-bit word address, memory above 256 bytes is addressed with
+ * the lower bits of the device address. */
+void stwi_sim_eeprom_init(struct stwi_sim_eeprom *eeprom,
+                          uint8_t addr,
+                          stwi_reg_size_t reg_size,
+                          uint8_t *mem,
+                          size_t size,
+                          uint16_t page_size,
+                          unsigned write_time);
+
+#endif /* SOFTBUS_STWI_SIM_H */
@@ -25,31 +25,65 @@
 
 #include "stwi.h"
 
-struct stwi_res stwi_dev_write(struct stwi const *bus,
-                               uint8_t addr,
-                               stwi_reg_size_t reg_size,
-                               uint16_t reg,
-                               uint8_t const *buff,
-                               size_t size)
+/* Generate start condition, send device address with WRITE bit and register address */
+static stwi_err_t stwi_dev_addr(struct stwi const *bus,
+                                uint8_t addr,
+                                stwi_reg_size_t reg_size,
+                                uint16_t reg,
+                                struct stwi_res *res)
 {
-    struct stwi_res res = {};
     /* Generate start condition */
-    res.stage = STWI_STAGE_START;
-    STWI_ASSERT(!(res.err = stwi_start(bus)), return res;);
+    res->stage = STWI_STAGE_START;
+    stwi_dev_select(bus, addr);
+    STWI_ASSERT(!(res->err = stwi_start(bus)), return res->err;);
     /* Send device address with WRITE bit */
-    res.stage = STWI_STAGE_ADDR;
-    STWI_ASSERT(!(res.err = stwi_write_byte(bus, addr << 1 | 0x00)), return res;);
+    res->stage = STWI_STAGE_ADDR;
+    STWI_ASSERT(!(res->err = stwi_write_byte(bus, addr << 1 | 0x00)), return res->err;);
     /* Send register high byte */
-    res.stage = STWI_STAGE_REG;
+    res->stage = STWI_STAGE_REG;
     if (reg_size == STWI_REG_16)
     {
-        STWI_ASSERT(!(res.err = stwi_write_byte(bus, reg >> 8 & 0xFF)), return res;);
+        STWI_ASSERT(!(res->err = stwi_write_byte(bus, reg >> 8 & 0xFF)), return res->err;);
     }
     /* Send register low byte */
     if (reg_size != STWI_REG_0)
     {
-        STWI_ASSERT(!(res.err = stwi_write_byte(bus, reg & 0xFF)), return res;);
+        STWI_ASSERT(!(res->err = stwi_write_byte(bus, reg & 0xFF)), return res->err;);
     }
+    return STWI_ERR_OK;
+}
+
+/* Generate (repeated) start condition and send device address with READ bit */
+static stwi_err_t stwi_dev_addr_read(struct stwi const *bus, uint8_t addr, struct stwi_res *res)
+{
+    /* Generate repeated start */
+    res->stage = STWI_STAGE_START;
+    stwi_dev_select(bus, addr);
+    STWI_ASSERT(!(res->err = stwi_start(bus)), return res->err;);
+    /* Send device address with READ bit */
+    res->stage = STWI_STAGE_ADDR;
+    STWI_ASSERT(!(res->err = stwi_write_byte(bus, addr << 1 | 0x01)), return res->err;);
+    return STWI_ERR_OK;
+}
+
+/* Check whether the operation continues data of the previous one at the next register,
+ * so it can be transferred without start condition and address bytes */
+static bool stwi_op_continues(struct stwi_op const *prev, struct stwi_op const *op)
+{
+    return op->dir == prev->dir && op->addr == prev->addr && op->reg_size == prev->reg_size &&
+           op->reg_size != STWI_REG_0 && prev->size && op->size &&
+           (uint16_t)(prev->reg + prev->size) == op->reg;
+}
+
+static struct stwi_res stwi_dev_write_do(struct stwi const *bus,
+                                         uint8_t addr,
+                                         stwi_reg_size_t reg_size,
+                                         uint16_t reg,
+                                         uint8_t const *buff,
+                                         size_t size)
+{
+    struct stwi_res res = {};
+    STWI_ASSERT(!stwi_dev_addr(bus, addr, reg_size, reg, &res), return res;);
     /* Send data */
     res.stage = STWI_STAGE_DATA;
     while (size--)
@@ -63,46 +97,454 @@ struct stwi_res stwi_dev_write(struct stwi const *bus,
     return res;
 }
 
-struct stwi_res stwi_dev_read(struct stwi const *bus,
-                              uint8_t addr,
-                              stwi_reg_size_t reg_size,
-                              uint16_t reg,
-                              uint8_t *buff,
-                              size_t size)
+static struct stwi_res stwi_dev_read_do(struct stwi const *bus,
+                                        uint8_t addr,
+                                        stwi_reg_size_t reg_size,
+                                        uint16_t reg,
+                                        uint8_t *buff,
+                                        size_t size)
 {
     struct stwi_res res = {};
-    /* Generate start condition */
-    res.stage = STWI_STAGE_START;
-    STWI_ASSERT(!(res.err = stwi_start(bus)), return res;);
-    /* Send device address with WRITE bit */
-    res.stage = STWI_STAGE_ADDR;
-    STWI_ASSERT(!(res.err = stwi_write_byte(bus, addr << 1 | 0x00)), return res;);
-    /* Send register high byte */
-    res.stage = STWI_STAGE_REG;
-    if (reg_size == STWI_REG_16)
+    STWI_ASSERT(!stwi_dev_addr(bus, addr, reg_size, reg, &res), return res;);
+    STWI_ASSERT(!stwi_dev_addr_read(bus, addr, &res), return res;);
+    /* Receive data */
+    res.stage = STWI_STAGE_DATA;
+    while (size--)
     {
-        STWI_ASSERT(!(res.err = stwi_write_byte(bus, (uint8_t)(reg >> 8 & 0xFF))), return res;);
+        STWI_ASSERT(!(res.err = stwi_read_byte(bus, buff++, size > 0)), return res;);
+        res.data_size++;
     }
-    /* Send register low byte */
-    if (reg_size != STWI_REG_0)
+    /* Generate stop condition */
+    res.stage = STWI_STAGE_STOP;
+    STWI_ASSERT(!(res.err = stwi_stop(bus)), return res;);
+    return res;
+}
+
+static struct stwi_res stwi_dev_writev_do(struct stwi const *bus,
+                                          uint8_t addr,
+                                          stwi_reg_size_t reg_size,
+                                          uint16_t reg,
+                                          struct stwi_iov_const const *iov,
+                                          size_t count)
+{
+    struct stwi_res res = {};
+    STWI_ASSERT(!stwi_dev_addr(bus, addr, reg_size, reg, &res), return res;);
+    /* Send data */
+    res.stage = STWI_STAGE_DATA;
+    for (; count--; iov++)
     {
-        STWI_ASSERT(!(res.err = stwi_write_byte(bus, (uint8_t)(reg & 0xFF))), return res;);
+        for (size_t i = 0; i < iov->size; i++)
+        {
+            STWI_ASSERT(!(res.err = stwi_write_byte(bus, iov->buff[i])), return res;);
+            res.data_size++;
+        }
     }
-    /* Generate repeated start */
-    res.stage = STWI_STAGE_START;
-    STWI_ASSERT(!(res.err = stwi_start(bus)), return res;);
-    /* Send device address with READ bit */
-    res.stage = STWI_STAGE_ADDR;
-    STWI_ASSERT(!(res.err = stwi_write_byte(bus, addr << 1 | 0x01)), return res;);
+    /* Generate stop condition */
+    res.stage = STWI_STAGE_STOP;
+    STWI_ASSERT(!(res.err = stwi_stop(bus)), return res;);
+    return res;
+}
+
+static struct stwi_res stwi_dev_readv_do(struct stwi const *bus,
+                                         uint8_t addr,
+                                         stwi_reg_size_t reg_size,
+                                         uint16_t reg,
+                                         struct stwi_iov const *iov,
+                                         size_t count)
+{
+    struct stwi_res res = {};
+    /* Total size is needed to send NACK after the last byte */
+    size_t size = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        size += iov[i].size;
+    }
+    STWI_ASSERT(!stwi_dev_addr(bus, addr, reg_size, reg, &res), return res;);
+    STWI_ASSERT(!stwi_dev_addr_read(bus, addr, &res), return res;);
     /* Receive data */
     res.stage = STWI_STAGE_DATA;
-    while (size--)
+    for (; count--; iov++)
     {
-        STWI_ASSERT(!(res.err = stwi_read_byte(bus, buff++, size > 0)), return res;);
+        for (size_t i = 0; i < iov->size; i++)
+        {
+            STWI_ASSERT(!(res.err = stwi_read_byte(bus, &iov->buff[i], res.data_size + 1 < size)), return res;);
+            res.data_size++;
+        }
+    }
+    /* Generate stop condition */
+    res.stage = STWI_STAGE_STOP;
+    STWI_ASSERT(!(res.err = stwi_stop(bus)), return res;);
+    return res;
+}
+
+static struct stwi_res stwi_dev_write_stream_do(struct stwi const *bus,
+                                                uint8_t addr,
+                                                stwi_reg_size_t reg_size,
+                                                uint16_t reg,
+                                                uint8_t *chunk,
+                                                size_t chunk_size,
+                                                stwi_producer_t producer,
+                                                void *ctx)
+{
+    struct stwi_res res = {};
+    STWI_ASSERT(!stwi_dev_addr(bus, addr, reg_size, reg, &res), return res;);
+    /* Send data */
+    res.stage = STWI_STAGE_DATA;
+    for (size_t size; (size = producer(ctx, chunk, chunk_size));)
+    {
+        if (size > chunk_size) { size = chunk_size; }
+        for (size_t i = 0; i < size; i++)
+        {
+            STWI_ASSERT(!(res.err = stwi_write_byte(bus, chunk[i])), return res;);
+            res.data_size++;
+        }
+    }
+    /* Generate stop condition */
+    res.stage = STWI_STAGE_STOP;
+    STWI_ASSERT(!(res.err = stwi_stop(bus)), return res;);
+    return res;
+}
+
+static struct stwi_res stwi_dev_read_stream_do(struct stwi const *bus,
+                                               uint8_t addr,
+                                               stwi_reg_size_t reg_size,
+                                               uint16_t reg,
+                                               uint8_t *chunk,
+                                               size_t chunk_size,
+                                               stwi_consumer_t consumer,
+                                               void *ctx)
+{
+    struct stwi_res res = {};
+    STWI_ASSERT(!stwi_dev_addr(bus, addr, reg_size, reg, &res), return res;);
+    STWI_ASSERT(!stwi_dev_addr_read(bus, addr, &res), return res;);
+    /* Receive data */
+    res.stage = STWI_STAGE_DATA;
+    size_t size = consumer(ctx, chunk, 0);
+    while (size)
+    {
+        if (size > chunk_size) { size = chunk_size; }
+        for (size_t i = 0; i + 1 < size; i++)
+        {
+            STWI_ASSERT(!(res.err = stwi_read_byte(bus, &chunk[i], true)), return res;);
+            res.data_size++;
+        }
+        /* The last byte of the chunk is acknowledged if the consumer requests more data */
+        STWI_ASSERT(!(res.err = stwi_read_data(bus, &chunk[size - 1])), return res;);
         res.data_size++;
+        size = consumer(ctx, chunk, size);
+        STWI_ASSERT(!(res.err = stwi_write_bit(bus, size ? STWI_PIN_LOW : STWI_PIN_HIGH)), return res;);
     }
     /* Generate stop condition */
     res.stage = STWI_STAGE_STOP;
     STWI_ASSERT(!(res.err = stwi_stop(bus)), return res;);
     return res;
-}
\ No newline at end of file
+}
+
+static size_t stwi_dev_batch_do(struct stwi const *bus,
+                                struct stwi_op const *ops,
+                                size_t count,
+                                struct stwi_res *res)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        struct stwi_op const *op = &ops[i];
+        res[i] = (struct stwi_res){};
+        if (i == 0 || !stwi_op_continues(&ops[i - 1], op))
+        {
+            /* Send register address, not needed for reads without register */
+            if (op->dir == STWI_DIR_WRITE || op->reg_size != STWI_REG_0)
+            {
+                STWI_ASSERT(!stwi_dev_addr(bus, op->addr, op->reg_size, op->reg, &res[i]), return i + 1;);
+            }
+            if (op->dir == STWI_DIR_READ)
+            {
+                STWI_ASSERT(!stwi_dev_addr_read(bus, op->addr, &res[i]), return i + 1;);
+            }
+        }
+        /* Send or receive data */
+        res[i].stage = STWI_STAGE_DATA;
+        if (op->dir == STWI_DIR_WRITE)
+        {
+            for (; res[i].data_size < op->size; res[i].data_size++)
+            {
+                STWI_ASSERT(!(res[i].err = stwi_write_byte(bus, op->buff[res[i].data_size])), return i + 1;);
+            }
+        }
+        else
+        {
+            /* The last byte is acknowledged if the next operation continues reading */
+            bool more = i + 1 < count && stwi_op_continues(op, &ops[i + 1]);
+            for (; res[i].data_size < op->size; res[i].data_size++)
+            {
+                bool ack = more || res[i].data_size + 1 < op->size;
+                STWI_ASSERT(!(res[i].err = stwi_read_byte(bus, &op->buff[res[i].data_size], ack)),
+                            return i + 1;);
+            }
+        }
+    }
+    /* Generate stop condition after the last operation */
+    if (count)
+    {
+        res[count - 1].stage = STWI_STAGE_STOP;
+        STWI_ASSERT(!(res[count - 1].err = stwi_stop(bus)), return count;);
+    }
+    return count;
+}
+
+/* Check whether the error can be ignored for the message */
+static bool stwi_msg_ignored(struct stwi_msg const *msg, stwi_err_t err)
+{
+    return err == STWI_ERR_NACK && (msg->flags & STWI_M_IGNORE_NAK);
+}
+
+static struct stwi_res stwi_transfer_do(struct stwi const *bus, struct stwi_msg *msgs, size_t count)
+{
+    struct stwi_res res = {};
+    for (size_t i = 0; i < count; i++)
+    {
+        struct stwi_msg *msg = &msgs[i];
+        bool read = msg->flags & STWI_M_RD;
+        if (i == 0 || !(msg->flags & STWI_M_NOSTART))
+        {
+            /* Generate (repeated) start condition */
+            res.stage = STWI_STAGE_START;
+            stwi_dev_select(bus, msg->addr);
+            STWI_ASSERT(!(res.err = stwi_start(bus)), return res;);
+            /* Send device address with direction bit */
+            res.stage = STWI_STAGE_ADDR;
+            res.err = stwi_write_byte(bus, msg->addr << 1 | (read ? 0x01 : 0x00));
+            STWI_ASSERT(!res.err || stwi_msg_ignored(msg, res.err), return res;);
+        }
+        /* Send or receive data */
+        res.stage = STWI_STAGE_DATA;
+        uint16_t j = 0;
+        if (!read)
+        {
+            for (; j < msg->len; j++)
+            {
+                res.err = stwi_write_byte(bus, msg->buf[j]);
+                STWI_ASSERT(!res.err || stwi_msg_ignored(msg, res.err), return res;);
+            }
+        }
+        else
+        {
+            /* The last byte is acknowledged if the next message continues reading */
+            bool more = i + 1 < count && (msgs[i + 1].flags & STWI_M_NOSTART) && (msgs[i + 1].flags & STWI_M_RD);
+            if ((msg->flags & STWI_M_RECV_LEN) && msg->len)
+            {
+                /* Receive count before deciding on its ACK, an empty count or one that
+                 * doesn't fit the buffer gets NACK and the transfer is ended */
+                STWI_ASSERT(!(res.err = stwi_read_data(bus, &msg->buf[0])), return res;);
+                bool const valid = msg->buf[0] && msg->buf[0] <= STWI_M_RECV_LEN_MAX;
+                STWI_ASSERT(!(res.err = stwi_write_bit(bus, valid ? STWI_PIN_LOW : STWI_PIN_HIGH)), return res;);
+                if (!valid)
+                {
+                    res.stage = STWI_STAGE_STOP;
+                    STWI_ASSERT(!(res.err = stwi_stop(bus)), return res;);
+                    res.err = STWI_ERR_SIZE;
+                    return res;
+                }
+                msg->len += msg->buf[0];
+                j++;
+            }
+            for (; j < msg->len; j++)
+            {
+                STWI_ASSERT(!(res.err = stwi_read_byte(bus, &msg->buf[j], more || j + 1 < msg->len)), return res;);
+            }
+        }
+        res.data_size++;
+    }
+    /* Generate stop condition after the last message */
+    res.stage = STWI_STAGE_STOP;
+    STWI_ASSERT(!(res.err = stwi_stop(bus)), return res;);
+    return res;
+}
+
+struct stwi_recovery stwi_recover(struct stwi const *bus)
+{
+    struct stwi_recovery rec = {};
+    struct stwi_timing const *timing = stwi_get_timing(bus);
+    stwi_pin_state_t sda;
+    /* Release lines, SCL state is unknown here */
+    bus->write_sda(bus, STWI_PIN_HIGH);
+    stwi_delay(bus, timing->su_dat);
+    stwi_write_scl(bus, STWI_PIN_HIGH, STWI_PIN_HIGH);
+    stwi_delay(bus, timing->rise);
+    /* SCL is held low only if it is still low after clock stretch timeout */
+    if (stwi_stretch_wait(bus) && bus->read_scl(bus) == STWI_PIN_LOW)
+    {
+        rec.scl_low = true;
+        rec.err = STWI_ERR_STRETCH;
+        return rec;
+    }
+    stwi_delay(bus, timing->high);
+    sda = bus->read_sda(bus);
+    rec.sda_low = (sda == STWI_PIN_LOW);
+    /* Clock out the rest of the byte the device is sending */
+    while (sda == STWI_PIN_LOW && rec.pulses < 9)
+    {
+        stwi_write_scl(bus, STWI_PIN_LOW, STWI_PIN_HIGH);
+        stwi_delay(bus, timing->hd_dat + timing->su_dat);
+        stwi_write_scl(bus, STWI_PIN_HIGH, STWI_PIN_HIGH);
+        stwi_delay(bus, timing->rise);
+        STWI_ASSERT(!(rec.err = stwi_stretch_wait(bus)), return rec;);
+        stwi_delay(bus, timing->high);
+        sda = bus->read_sda(bus);
+        rec.pulses++;
+    }
+    /* Generate stop condition, it also resets devices that got clock pulses */
+    stwi_write_scl(bus, STWI_PIN_LOW, STWI_PIN_HIGH);
+    stwi_delay(bus, timing->hd_dat);
+    STWI_ASSERT(!(rec.err = stwi_stop(bus)), return rec;);
+    STWI_ASSERT(bus->read_sda(bus) == STWI_PIN_HIGH, rec.err = STWI_ERR_BUS;);
+    return rec;
+}
+
+/* Recover the bus before complex operation if a line is held low by a device */
+static stwi_err_t stwi_recover_before(struct stwi const *bus)
+{
+    stwi_pin_state_t scl, sda;
+    STWI_ASSERT(bus->recover, return STWI_ERR_OK;);
+    struct stwi_timing const *timing = stwi_get_timing(bus);
+    /* Release lines the master may have left low (e.g. by a transfer without stop condition) */
+    bus->write_sda(bus, STWI_PIN_HIGH);
+    stwi_delay(bus, timing->su_dat);
+    stwi_write_scl(bus, STWI_PIN_HIGH, STWI_PIN_HIGH);
+    stwi_delay(bus, timing->rise);
+    stwi_read_lines(bus, &scl, &sda);
+    STWI_ASSERT(scl == STWI_PIN_LOW || sda == STWI_PIN_LOW, return STWI_ERR_OK;);
+    stwi_stats_recover(bus);
+    return stwi_recover(bus).err;
+}
+
+/* Recover the bus after clock stretch timeout of complex operation */
+static void stwi_recover_after(struct stwi const *bus, stwi_err_t err)
+{
+    STWI_ASSERT(bus->recover && err == STWI_ERR_STRETCH, return;);
+    stwi_stats_recover(bus);
+    stwi_recover(bus);
+}
+
+/* Public functions wrap the operations above to update statistics and recover the bus */
+
+struct stwi_res stwi_dev_write(struct stwi const *bus,
+                               uint8_t addr,
+                               stwi_reg_size_t reg_size,
+                               uint16_t reg,
+                               uint8_t const *buff,
+                               size_t size)
+{
+    uint32_t start = stwi_stats_time(bus);
+    struct stwi_res res = {.err = stwi_recover_before(bus)};
+    if (!res.err) { res = stwi_dev_write_do(bus, addr, reg_size, reg, buff, size); }
+    stwi_recover_after(bus, res.err);
+    stwi_stats_res(bus, start, &res);
+    return res;
+}
+
+struct stwi_res stwi_dev_read(struct stwi const *bus,
+                              uint8_t addr,
+                              stwi_reg_size_t reg_size,
+                              uint16_t reg,
+                              uint8_t *buff,
+                              size_t size)
+{
+    uint32_t start = stwi_stats_time(bus);
+    struct stwi_res res = {.err = stwi_recover_before(bus)};
+    if (!res.err) { res = stwi_dev_read_do(bus, addr, reg_size, reg, buff, size); }
+    stwi_recover_after(bus, res.err);
+    stwi_stats_res(bus, start, &res);
+    return res;
+}
+
+struct stwi_res stwi_dev_writev(struct stwi const *bus,
+                                uint8_t addr,
+                                stwi_reg_size_t reg_size,
+                                uint16_t reg,
+                                struct stwi_iov_const const *iov,
+                                size_t count)
+{
+    uint32_t start = stwi_stats_time(bus);
+    struct stwi_res res = {.err = stwi_recover_before(bus)};
+    if (!res.err) { res = stwi_dev_writev_do(bus, addr, reg_size, reg, iov, count); }
+    stwi_recover_after(bus, res.err);
+    stwi_stats_res(bus, start, &res);
+    return res;
+}
+
+struct stwi_res stwi_dev_readv(struct stwi const *bus,
+                               uint8_t addr,
+                               stwi_reg_size_t reg_size,
+                               uint16_t reg,
+                               struct stwi_iov const *iov,
+                               size_t count)
+{
+    uint32_t start = stwi_stats_time(bus);
+    struct stwi_res res = {.err = stwi_recover_before(bus)};
+    if (!res.err) { res = stwi_dev_readv_do(bus, addr, reg_size, reg, iov, count); }
+    stwi_recover_after(bus, res.err);
+    stwi_stats_res(bus, start, &res);
+    return res;
+}
+
+struct stwi_res stwi_dev_write_stream(struct stwi const *bus,
+                                      uint8_t addr,
+                                      stwi_reg_size_t reg_size,
+                                      uint16_t reg,
+                                      uint8_t *chunk,
+                                      size_t chunk_size,
+                                      stwi_producer_t producer,
+                                      void *ctx)
+{
+    STWI_ASSERT(chunk_size, return (struct stwi_res){.err = STWI_ERR_SIZE};);
+    uint32_t start = stwi_stats_time(bus);
+    struct stwi_res res = {.err = stwi_recover_before(bus)};
+    if (!res.err) { res = stwi_dev_write_stream_do(bus, addr, reg_size, reg, chunk, chunk_size, producer, ctx); }
+    stwi_recover_after(bus, res.err);
+    stwi_stats_res(bus, start, &res);
+    return res;
+}
+
+struct stwi_res stwi_dev_read_stream(struct stwi const *bus,
+                                     uint8_t addr,
+                                     stwi_reg_size_t reg_size,
+                                     uint16_t reg,
+                                     uint8_t *chunk,
+                                     size_t chunk_size,
+                                     stwi_consumer_t consumer,
+                                     void *ctx)
+{
+    STWI_ASSERT(chunk_size, return (struct stwi_res){.err = STWI_ERR_SIZE};);
+    uint32_t start = stwi_stats_time(bus);
+    struct stwi_res res = {.err = stwi_recover_before(bus)};
+    if (!res.err) { res = stwi_dev_read_stream_do(bus, addr, reg_size, reg, chunk, chunk_size, consumer, ctx); }
+    stwi_recover_after(bus, res.err);
+    stwi_stats_res(bus, start, &res);
+    return res;
+}
+
+size_t stwi_dev_batch(struct stwi const *bus,
+                      struct stwi_op const *ops,
+                      size_t count,
+                      struct stwi_res *res)
+{
+    uint32_t start = stwi_stats_time(bus);
+    STWI_ASSERT(count, return 0;);
+    size_t done = 1;
+    res[0] = (struct stwi_res){.err = stwi_recover_before(bus)};
+    if (!res[0].err) { done = stwi_dev_batch_do(bus, ops, count, res); }
+    stwi_recover_after(bus, res[done - 1].err);
+    stwi_stats_res(bus, start, &res[done - 1]);
+    return done;
+}
+
+struct stwi_res stwi_transfer(struct stwi const *bus, struct stwi_msg *msgs, size_t count)
+{
+    uint32_t start = stwi_stats_time(bus);
+    STWI_ASSERT(count, return (struct stwi_res){};);
+    struct stwi_res res = {.err = stwi_recover_before(bus)};
+    if (!res.err) { res = stwi_transfer_do(bus, msgs, count); }
+    stwi_recover_after(bus, res.err);
+    stwi_stats_res(bus, start, &res);
+    return res;
+}
@@ -30,6 +30,15 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Set to 1 to collect bus statistics (see 'struct stwi_stats') */
+#ifndef STWI_STATS
+#define STWI_STATS 0
+#endif
+
 /* Error codes */
 typedef enum
 {
@@ -39,6 +48,12 @@ typedef enum
     STWI_ERR_STRETCH,
     /* NACK received */
     STWI_ERR_NACK,
+    /* SDA line is held low by a device */
+    STWI_ERR_BUS,
+    /* Packet error code (SMBus PEC) mismatch */
+    STWI_ERR_PEC,
+    /* Data size exceeds the limit of the operation, nothing is transferred */
+    STWI_ERR_SIZE,
 } stwi_err_t;
 
 /* Complex operation progress */
@@ -56,6 +71,20 @@ typedef enum
     STWI_STAGE_STOP,
 } stwi_stage_t;
 
+/* Bus recovery result */
+struct stwi_recovery
+{
+    /* SCL line was held low after it had been released (longer than clock stretch timeout) */
+    bool scl_low;
+    /* SDA line was held low after it had been released */
+    bool sda_low;
+    /* Number of clock pulses generated to release SDA */
+    uint8_t pulses;
+    /* STWI_ERR_OK if the bus is free, STWI_ERR_STRETCH if SCL is held low,
+     * STWI_ERR_BUS if SDA is held low */
+    stwi_err_t err;
+};
+
 /* Complex operation result */
 struct stwi_res
 {
@@ -73,6 +102,21 @@ typedef enum
     STWI_PIN_HIGH,
 } stwi_pin_state_t;
 
+/* Transfer direction */
+typedef enum
+{
+    STWI_DIR_WRITE,
+    STWI_DIR_READ,
+} stwi_dir_t;
+
+/* Producer of streamed data: fill 'chunk' with up to 'size' bytes to be sent.
+ * Returns number of bytes, zero ends the transfer. */
+typedef size_t (*stwi_producer_t)(void *ctx, uint8_t *chunk, size_t size);
+
+/* Consumer of streamed data: 'chunk' holds 'size' received bytes (zero for the first call).
+ * Returns number of bytes to be received next (up to the chunk size), zero ends the transfer. */
+typedef size_t (*stwi_consumer_t)(void *ctx, uint8_t const *chunk, size_t size);
+
 /* Register size in bits */
 typedef enum
 {
@@ -81,6 +125,118 @@ typedef enum
     STWI_REG_16,
 } stwi_reg_size_t;
 
+/* Durations of bit phases in periods of 'delay' (a quarter period of the clock by default).
+ * Zero skips the phase delay, e.g. data hold time is zero by the bus specification. */
+struct stwi_timing
+{
+    /* SCL low time after SDA change (data setup, start: bus release) */
+    uint8_t su_dat;
+    /* SCL high time before checking for clock stretch (rise time) */
+    uint8_t rise;
+    /* SCL high time after clock stretch (start: start hold, stop: bus free time) */
+    uint8_t high;
+    /* SCL low time before SDA change (data hold) */
+    uint8_t hd_dat;
+};
+
+struct stwi;
+
+/* Clock stretch polling strategy. SCL is polled without waiting 'spin' times, then the wait
+ * between polls starts from one period of 'delay' and is doubled while it doesn't exceed 'backoff_max'. */
+struct stwi_stretch
+{
+    /* Number of polls without waiting */
+    unsigned spin;
+    /* Maximum wait between polls in periods of 'delay' (zero or one disable backoff) */
+    unsigned backoff_max;
+    /* Optional: wait for 'n' periods of 'delay' letting other tasks run (yield or sleep),
+     * used for waits longer than 'yield_after' periods */
+    void (*yield)(struct stwi const *bus, unsigned n);
+    unsigned yield_after;
+};
+
+/* Data segment of scatter-gather reads */
+struct stwi_iov
+{
+    /* Buffer for received data */
+    uint8_t *buff;
+    size_t size;
+};
+
+/* Data segment of scatter-gather writes */
+struct stwi_iov_const
+{
+    /* Data to send */
+    uint8_t const *buff;
+    size_t size;
+};
+
+/* Operation of a batch */
+struct stwi_op
+{
+    stwi_dir_t dir;
+    /* 7-bit device address */
+    uint8_t addr;
+    stwi_reg_size_t reg_size;
+    uint16_t reg;
+    /* Data to send or buffer for received data */
+    uint8_t *buff;
+    size_t size;
+};
+
+/* Message flags, values match the Linux i2c_msg ones */
+/* Read data from the device */
+#define STWI_M_RD 0x0001
+/* First received byte is the count of following bytes, it is added to 'len' */
+#define STWI_M_RECV_LEN 0x0400
+/* Continue the transfer on NACK of the address or data bytes */
+#define STWI_M_IGNORE_NAK 0x1000
+/* Continue data of the previous message without start condition and address byte */
+#define STWI_M_NOSTART 0x4000
+
+/* Maximum count received for a message with STWI_M_RECV_LEN (SMBus block size) */
+#define STWI_M_RECV_LEN_MAX 32
+
+/* Message of a transfer, same as the Linux i2c_msg */
+struct stwi_msg
+{
+    /* 7-bit device address */
+    uint8_t addr;
+    uint16_t flags;
+    /* Data size, with STWI_M_RECV_LEN: number of bytes before the count is added
+     * (one for the count byte, plus one for PEC byte if any) */
+    uint16_t len;
+    /* Data to send or buffer for received data,
+     * with STWI_M_RECV_LEN it must fit 'len' + STWI_M_RECV_LEN_MAX bytes */
+    uint8_t *buf;
+};
+
+/* Number of buckets of statistics histograms */
+#define STWI_STATS_BUCKETS 16
+
+/* Bus statistics */
+struct stwi_stats
+{
+    /* Optional: get current time in any units (e.g. timer ticks) for histograms */
+    uint32_t (*timestamp)(struct stwi const *bus);
+    /* Sent and received bytes including addresses */
+    uint32_t bytes;
+    /* Complex operations */
+    uint32_t transactions;
+    /* Complex operations failed with NACK by stage */
+    uint32_t nacks[STWI_STAGE_STOP + 1];
+    /* Clock stretches and their timeouts */
+    uint32_t stretches;
+    uint32_t timeouts;
+    /* Bus recoveries performed by complex operations */
+    uint32_t recoveries;
+    /* Histograms of clock stretch and complex operation durations:
+     * bucket 0 counts zero durations, bucket N counts durations from 2^(N-1) to 2^N - 1,
+     * the last bucket also counts longer durations */
+    uint32_t stretch_hist[STWI_STATS_BUCKETS];
+    uint32_t latency_hist[STWI_STATS_BUCKETS];
+};
+
 /* Software TWI bus handle */
 struct stwi
 {
@@ -99,72 +255,296 @@ struct stwi
     /* Check whether clock stretching timeout is not expired.
      * If you want to disable clock stretch you should just return 'false' always. */
     bool (*timeout_check)(struct stwi const *bus);
+    /* Optional: set states of both SCL and SDA pins at once (e.g. with one port write) */
+    void (*write_lines)(struct stwi const *bus, stwi_pin_state_t scl, stwi_pin_state_t sda);
+    /* Optional: get states of both SCL and SDA pins at once (e.g. with one port read),
+     * received bits are sampled with it together with the clock stretch check */
+    void (*read_lines)(struct stwi const *bus, stwi_pin_state_t *scl, stwi_pin_state_t *sda);
+    /* Optional: wait for 'n' periods of 'delay' at once */
+    void (*delay_n)(struct stwi const *bus, unsigned n);
+    /* Optional: bit timing, one period of 'delay' for every phase if not set */
+    struct stwi_timing const *timing;
+    /* Optional: clock stretch polling strategy, SCL is polled after every 'delay' if not set */
+    struct stwi_stretch const *stretch;
+    /* Optional: complex operations recover the bus (see stwi_recover()) if SCL or SDA line is
+     * held low by a device before start condition (the lines are released first) or after
+     * clock stretch timeout */
+    bool recover;
+    /* Optional: the device with 7-bit address is going to be addressed by a complex operation,
+     * called before start condition (e.g. to apply clock speed of the device, see "stwi_speed.h") */
+    void (*dev_select)(struct stwi const *bus, uint8_t addr);
+    /* Optional: statistics updated by the driver compiled with STWI_STATS=1,
+     * the member is present in any configuration to keep the layout the same */
+    struct stwi_stats *stats;
 };
 
 #define STWI_ASSERT(exp, act) \
     if (!(exp)) { act }
 
+#if STWI_STATS
+/* Get timestamp for statistics */
+static inline uint32_t stwi_stats_time(struct stwi const *bus)
+{
+    return (bus->stats && bus->stats->timestamp) ? bus->stats->timestamp(bus) : 0;
+}
+
+/* Count duration in histogram */
+static inline void stwi_stats_hist(uint32_t *hist, uint32_t duration)
+{
+    int bucket = 0;
+    while (duration && bucket < STWI_STATS_BUCKETS - 1)
+    {
+        duration >>= 1;
+        bucket++;
+    }
+    hist[bucket]++;
+}
+
+/* Count sent or received byte */
+static inline void stwi_stats_byte(struct stwi const *bus)
+{
+    if (bus->stats) { bus->stats->bytes++; }
+}
+
+/* Count clock stretch started at the specified time */
+static inline void stwi_stats_stretch(struct stwi const *bus, uint32_t start, bool timeout)
+{
+    STWI_ASSERT(bus->stats, return;);
+    bus->stats->stretches++;
+    if (timeout) { bus->stats->timeouts++; }
+    stwi_stats_hist(bus->stats->stretch_hist, stwi_stats_time(bus) - start);
+}
+
+/* Count complex operation started at the specified time */
+static inline void stwi_stats_res(struct stwi const *bus, uint32_t start, struct stwi_res const *res)
+{
+    STWI_ASSERT(bus->stats, return;);
+    bus->stats->transactions++;
+    if (res->err == STWI_ERR_NACK) { bus->stats->nacks[res->stage]++; }
+    stwi_stats_hist(bus->stats->latency_hist, stwi_stats_time(bus) - start);
+}
+
+/* Count bus recovery */
+static inline void stwi_stats_recover(struct stwi const *bus)
+{
+    if (bus->stats) { bus->stats->recoveries++; }
+}
+#else
+static inline uint32_t stwi_stats_time(struct stwi const *bus)
+{
+    (void)bus;
+    return 0;
+}
+
+static inline void stwi_stats_byte(struct stwi const *bus)
+{
+    (void)bus;
+}
+
+static inline void stwi_stats_stretch(struct stwi const *bus, uint32_t start, bool timeout)
+{
+    (void)bus;
+    (void)start;
+    (void)timeout;
+}
+
+static inline void stwi_stats_res(struct stwi const *bus, uint32_t start, struct stwi_res const *res)
+{
+    (void)bus;
+    (void)start;
+    (void)res;
+}
+
+static inline void stwi_stats_recover(struct stwi const *bus)
+{
+    (void)bus;
+}
+#endif
+
+/* Default bit timing: quarter period for every phase */
+static struct stwi_timing const stwi_timing_default = {.su_dat = 1, .rise = 1, .high = 1, .hd_dat = 1};
+
+/* Get bit timing of the bus */
+static inline struct stwi_timing const *stwi_get_timing(struct stwi const *bus)
+{
+    return bus->timing ? bus->timing : &stwi_timing_default;
+}
+
+/* Wait for 'n' periods of 'delay' */
+static inline void stwi_delay(struct stwi const *bus, unsigned n)
+{
+    if (bus->delay_n)
+    {
+        if (n) { bus->delay_n(bus, n); }
+    }
+    else
+    {
+        while (n--) { bus->delay(bus); }
+    }
+}
+
+/* Notify that the device with 7-bit address is going to be addressed */
+static inline void stwi_dev_select(struct stwi const *bus, uint8_t addr)
+{
+    if (bus->dev_select) { bus->dev_select(bus, addr); }
+}
+
+/* Set state of the SCL pin while the SDA pin keeps the specified state */
+static inline void stwi_write_scl(struct stwi const *bus, stwi_pin_state_t scl, stwi_pin_state_t sda)
+{
+    if (bus->write_lines) { bus->write_lines(bus, scl, sda); }
+    else { bus->write_scl(bus, scl); }
+}
+
+/* Set state of the SDA pin while the SCL pin keeps the specified state */
+static inline void stwi_write_sda(struct stwi const *bus, stwi_pin_state_t scl, stwi_pin_state_t sda)
+{
+    if (bus->write_lines) { bus->write_lines(bus, scl, sda); }
+    else { bus->write_sda(bus, sda); }
+}
+
+/* Get states of both SCL and SDA pins */
+static inline void stwi_read_lines(struct stwi const *bus, stwi_pin_state_t *scl, stwi_pin_state_t *sda)
+{
+    if (bus->read_lines) { bus->read_lines(bus, scl, sda); }
+    else
+    {
+        *scl = bus->read_scl(bus);
+        *sda = bus->read_sda(bus);
+    }
+}
+
 /* Wait until slave device releases SCL line (clock stretch) */
 static inline stwi_err_t stwi_stretch_wait(struct stwi const *bus)
 {
     if (bus->read_scl(bus) == STWI_PIN_LOW)
     {
+        uint32_t start = stwi_stats_time(bus);
+        struct stwi_stretch const *stretch = bus->stretch;
+        unsigned spin = stretch ? stretch->spin : 0;
+        unsigned wait = 1;
         bus->timeout_start(bus);
         do
         {
-            STWI_ASSERT(bus->timeout_check(bus), return STWI_ERR_STRETCH;);
-            bus->delay(bus);
+            STWI_ASSERT(bus->timeout_check(bus), stwi_stats_stretch(bus, start, true); return STWI_ERR_STRETCH;);
+            if (spin)
+            {
+                spin--;
+                continue;
+            }
+            if (!stretch) { bus->delay(bus); }
+            else
+            {
+                if (stretch->yield && wait > stretch->yield_after) { stretch->yield(bus, wait); }
+                else { stwi_delay(bus, wait); }
+                /* Exponential backoff */
+                if (wait * 2 <= stretch->backoff_max) { wait *= 2; }
+            }
         } while (bus->read_scl(bus) == STWI_PIN_LOW);
+        stwi_stats_stretch(bus, start, false);
     }
     return STWI_ERR_OK;
 }
 
-/* Generate clock pulse and send one bit */
-static inline stwi_err_t stwi_write_bit(struct stwi const *bus, stwi_pin_state_t bit)
+/* Generate clock pulse for the bit already set on SDA line with the specified timing
+ * (SCL line is expected to be low) */
+static inline stwi_err_t stwi_clock_bit_timed(struct stwi const *bus,
+                                              struct stwi_timing const *timing,
+                                              stwi_pin_state_t bit)
 {
     stwi_err_t err;
-    bus->write_sda(bus, bit);
-    bus->delay(bus);
-    bus->write_scl(bus, STWI_PIN_HIGH);
-    bus->delay(bus);
+    stwi_delay(bus, timing->su_dat);
+    stwi_write_scl(bus, STWI_PIN_HIGH, bit);
+    stwi_delay(bus, timing->rise);
     STWI_ASSERT(!(err = stwi_stretch_wait(bus)), return err;);
-    bus->delay(bus);
-    bus->write_scl(bus, STWI_PIN_LOW);
-    bus->delay(bus);
+    stwi_delay(bus, timing->high);
+    stwi_write_scl(bus, STWI_PIN_LOW, bit);
+    stwi_delay(bus, timing->hd_dat);
     return STWI_ERR_OK;
 }
 
-/* Generate clock pulse and receive one bit */
-static inline stwi_err_t stwi_read_bit(struct stwi const *bus, stwi_pin_state_t *bit)
+/* Generate clock pulse and send one bit with the specified timing (SCL line is expected to be low) */
+static inline stwi_err_t stwi_write_bit_timed(struct stwi const *bus,
+                                              struct stwi_timing const *timing,
+                                              stwi_pin_state_t bit)
+{
+    stwi_write_sda(bus, STWI_PIN_LOW, bit);
+    return stwi_clock_bit_timed(bus, timing, bit);
+}
+
+/* Generate clock pulse and send one bit (SCL line is expected to be low) */
+static inline stwi_err_t stwi_write_bit(struct stwi const *bus, stwi_pin_state_t bit)
+{
+    return stwi_write_bit_timed(bus, stwi_get_timing(bus), bit);
+}
+
+/* Generate clock pulse and sample the bit on SDA line already released with the specified timing
+ * (SCL line is expected to be low) */
+static inline stwi_err_t stwi_sample_bit_timed(struct stwi const *bus,
+                                               struct stwi_timing const *timing,
+                                               stwi_pin_state_t *bit)
 {
     stwi_err_t err;
-    bus->write_sda(bus, STWI_PIN_HIGH);
-    bus->delay(bus);
-    bus->write_scl(bus, STWI_PIN_HIGH);
-    bus->delay(bus);
-    STWI_ASSERT(!(err = stwi_stretch_wait(bus)), return err;);
-    bus->delay(bus);
-    *bit = bus->read_sda(bus);
-    bus->write_scl(bus, STWI_PIN_LOW);
-    bus->delay(bus);
+    stwi_delay(bus, timing->su_dat);
+    stwi_write_scl(bus, STWI_PIN_HIGH, STWI_PIN_HIGH);
+    if (bus->read_lines)
+    {
+        /* Check for clock stretch when SDA is sampled: one callback per bit.
+         * SDA sampled while SCL is held low is discarded. */
+        stwi_pin_state_t scl;
+        stwi_delay(bus, timing->rise + timing->high);
+        bus->read_lines(bus, &scl, bit);
+        while (scl == STWI_PIN_LOW)
+        {
+            STWI_ASSERT(!(err = stwi_stretch_wait(bus)), return err;);
+            stwi_delay(bus, timing->high);
+            bus->read_lines(bus, &scl, bit);
+        }
+    }
+    else
+    {
+        stwi_delay(bus, timing->rise);
+        STWI_ASSERT(!(err = stwi_stretch_wait(bus)), return err;);
+        stwi_delay(bus, timing->high);
+        *bit = bus->read_sda(bus);
+    }
+    stwi_write_scl(bus, STWI_PIN_LOW, STWI_PIN_HIGH);
+    stwi_delay(bus, timing->hd_dat);
     return STWI_ERR_OK;
 }
 
+/* Generate clock pulse and receive one bit with the specified timing (SCL line is expected to be low) */
+static inline stwi_err_t stwi_read_bit_timed(struct stwi const *bus,
+                                             struct stwi_timing const *timing,
+                                             stwi_pin_state_t *bit)
+{
+    stwi_write_sda(bus, STWI_PIN_LOW, STWI_PIN_HIGH);
+    return stwi_sample_bit_timed(bus, timing, bit);
+}
+
+/* Generate clock pulse and receive one bit (SCL line is expected to be low) */
+static inline stwi_err_t stwi_read_bit(struct stwi const *bus, stwi_pin_state_t *bit)
+{
+    return stwi_read_bit_timed(bus, stwi_get_timing(bus), bit);
+}
+
 /* Generate start or repeated start condition */
 static inline stwi_err_t stwi_start(struct stwi const *bus)
 {
     stwi_err_t err;
-    /* Release lines (necessary for repeated start) */
+    struct stwi_timing const *timing = stwi_get_timing(bus);
+    /* Release lines (necessary for repeated start).
+     * SCL state is unknown here (idle or repeated start), so only SDA is written. */
     bus->write_sda(bus, STWI_PIN_HIGH);
-    bus->delay(bus);
-    bus->write_scl(bus, STWI_PIN_HIGH);
-    bus->delay(bus);
+    stwi_delay(bus, timing->su_dat);
+    stwi_write_scl(bus, STWI_PIN_HIGH, STWI_PIN_HIGH);
+    stwi_delay(bus, timing->rise);
     STWI_ASSERT(!(err = stwi_stretch_wait(bus)), return err;);
     /* Generate srart */
-    bus->write_sda(bus, STWI_PIN_LOW);
-    bus->delay(bus);
-    bus->write_scl(bus, STWI_PIN_LOW);
-    bus->delay(bus);
+    stwi_write_sda(bus, STWI_PIN_HIGH, STWI_PIN_LOW);
+    stwi_delay(bus, timing->high);
+    stwi_write_scl(bus, STWI_PIN_LOW, STWI_PIN_LOW);
+    stwi_delay(bus, timing->hd_dat);
     return STWI_ERR_OK;
 }
 
@@ -172,13 +552,14 @@ static inline stwi_err_t stwi_start(struct stwi const *bus)
 static inline stwi_err_t stwi_stop(struct stwi const *bus)
 {
     stwi_err_t err;
-    bus->write_sda(bus, STWI_PIN_LOW);
-    bus->delay(bus);
-    bus->write_scl(bus, STWI_PIN_HIGH);
-    bus->delay(bus);
+    struct stwi_timing const *timing = stwi_get_timing(bus);
+    stwi_write_sda(bus, STWI_PIN_LOW, STWI_PIN_LOW);
+    stwi_delay(bus, timing->su_dat);
+    stwi_write_scl(bus, STWI_PIN_HIGH, STWI_PIN_LOW);
+    stwi_delay(bus, timing->rise);
     STWI_ASSERT(!(err = stwi_stretch_wait(bus)), return err;);
-    bus->write_sda(bus, STWI_PIN_HIGH);
-    bus->delay(bus);
+    stwi_write_sda(bus, STWI_PIN_HIGH, STWI_PIN_HIGH);
+    stwi_delay(bus, timing->high);
     return STWI_ERR_OK;
 }
 
@@ -186,37 +567,66 @@ static inline stwi_err_t stwi_stop(struct stwi const *bus)
 static inline stwi_err_t stwi_write_byte(struct stwi const *bus, uint8_t byte)
 {
     stwi_err_t err;
-    /* Send byte */
-    for (int i = 0; i < 8; i++)
+    /* Local copy of timing isn't reloaded after every callback */
+    struct stwi_timing const timing = *stwi_get_timing(bus);
+    /* SDA is written for the first bit and for the bits whose level differs from the previous
+     * one, the lines take the same levels as if it were written for every bit */
+    uint8_t const changes = (uint8_t)(byte ^ byte >> 1) | 0x80;
+    stwi_stats_byte(bus);
+    /* Send byte, the value of a bit is its pin state */
+    for (int i = 7; i >= 0; i--)
     {
-        err = stwi_write_bit(bus, (byte & 0x80) ? STWI_PIN_HIGH : STWI_PIN_LOW);
-        STWI_ASSERT(!err, return err;);
-        byte <<= 1;
+        stwi_pin_state_t const level = (stwi_pin_state_t)(byte >> i & 0x01);
+        if (changes >> i & 0x01) { stwi_write_sda(bus, STWI_PIN_LOW, level); }
+        STWI_ASSERT(!(err = stwi_clock_bit_timed(bus, &timing, level)), return err;);
     }
-    /* Receive ACK or NACK bit */
+    /* Receive ACK or NACK bit, SDA is already released after a high bit */
+    if (!(byte & 0x01)) { stwi_write_sda(bus, STWI_PIN_LOW, STWI_PIN_HIGH); }
     stwi_pin_state_t bit;
-    STWI_ASSERT(!(err = stwi_read_bit(bus, &bit)), return err;);
+    STWI_ASSERT(!(err = stwi_sample_bit_timed(bus, &timing, &bit)), return err;);
     return (bit == STWI_PIN_LOW) ? STWI_ERR_OK : STWI_ERR_NACK;
 }
 
-/* Receive one byte and send ACK or NACK bit */
-static inline stwi_err_t stwi_read_byte(struct stwi const *bus, uint8_t *byte, bool ack)
+/* Receive one byte without ACK or NACK bit, it has to be sent with stwi_write_bit() */
+static inline stwi_err_t stwi_read_data(struct stwi const *bus, uint8_t *byte)
 {
     stwi_err_t err;
     uint8_t data = 0;
-    /* Receive byte */
+    /* Local copy of timing isn't reloaded after every callback */
+    struct stwi_timing const timing = *stwi_get_timing(bus);
+    stwi_stats_byte(bus);
+    /* SDA is released once for the whole byte */
+    stwi_write_sda(bus, STWI_PIN_LOW, STWI_PIN_HIGH);
     for (int i = 0; i < 8; i++)
     {
         stwi_pin_state_t bit;
-        STWI_ASSERT(!(err = stwi_read_bit(bus, &bit)), return err;);
-        data = data << 1 | ((bit == STWI_PIN_HIGH) ? 0x01 : 0x00);
+        STWI_ASSERT(!(err = stwi_sample_bit_timed(bus, &timing, &bit)), return err;);
+        data = data << 1 | (bit == STWI_PIN_HIGH);
     }
-    /* Send ACK or NACK bit */
-    STWI_ASSERT(!(err = stwi_write_bit(bus, ack ? STWI_PIN_LOW : STWI_PIN_HIGH)), return err;);
     *byte = data;
     return STWI_ERR_OK;
 }
 
+/* Receive one byte and send ACK or NACK bit */
+static inline stwi_err_t stwi_read_byte(struct stwi const *bus, uint8_t *byte, bool ack)
+{
+    stwi_err_t err;
+    uint8_t data;
+    /* Receive byte */
+    STWI_ASSERT(!(err = stwi_read_data(bus, &data)), return err;);
+    /* Send ACK or NACK bit, SDA is still released for NACK */
+    if (ack) { stwi_write_sda(bus, STWI_PIN_LOW, STWI_PIN_LOW); }
+    STWI_ASSERT(!(err = stwi_clock_bit_timed(bus, stwi_get_timing(bus), ack ? STWI_PIN_LOW : STWI_PIN_HIGH)),
+                return err;);
+    *byte = data;
+    return STWI_ERR_OK;
+}
+
+/* Free the bus held by a device that has been interrupted in the middle of a transfer:
+ * release both lines, generate up to nine clock pulses until SDA is released (the device
+ * finishes sending the byte and gets NACK) and generate stop condition */
+struct stwi_recovery stwi_recover(struct stwi const *bus);
+
 /* Send data array to the specified register of the device with 7-bit address */
 struct stwi_res stwi_dev_write(struct stwi const *bus,
                                uint8_t addr,
@@ -233,4 +643,77 @@ struct stwi_res stwi_dev_read(struct stwi const *bus,
                               uint8_t *buff,
                               size_t size);
 
+/* Send data segments to the specified register of the device with 7-bit address as one
+ * data array. Data size of the result counts bytes across all segments. */
+struct stwi_res stwi_dev_writev(struct stwi const *bus,
+                                uint8_t addr,
+                                stwi_reg_size_t reg_size,
+                                uint16_t reg,
+                                struct stwi_iov_const const *iov,
+                                size_t count);
+
+/* Receive data array from the specified register of the device with 7-bit address into
+ * data segments. Data size of the result counts bytes across all segments. */
+struct stwi_res stwi_dev_readv(struct stwi const *bus,
+                               uint8_t addr,
+                               stwi_reg_size_t reg_size,
+                               uint16_t reg,
+                               struct stwi_iov const *iov,
+                               size_t count);
+
+/* Send data to the specified register of the device with 7-bit address as one transaction,
+ * the data is pulled from the producer in chunks of up to 'chunk_size' bytes stored in 'chunk'.
+ * The chunk must not be empty, STWI_ERR_SIZE is returned without transfer otherwise.
+ * Data size of the result counts bytes across all chunks. */
+struct stwi_res stwi_dev_write_stream(struct stwi const *bus,
+                                      uint8_t addr,
+                                      stwi_reg_size_t reg_size,
+                                      uint16_t reg,
+                                      uint8_t *chunk,
+                                      size_t chunk_size,
+                                      stwi_producer_t producer,
+                                      void *ctx);
+
+/* Receive data from the specified register of the device with 7-bit address as one
+ * transaction, the data is pushed to the consumer in chunks of requested size stored in
+ * 'chunk'. The consumer is called before ACK bit of the last byte of a chunk, so the total
+ * size may be found from the data (the byte is acknowledged if more data is requested).
+ * The chunk must not be empty, STWI_ERR_SIZE is returned without transfer otherwise.
+ * Data size of the result counts bytes across all chunks. */
+struct stwi_res stwi_dev_read_stream(struct stwi const *bus,
+                                     uint8_t addr,
+                                     stwi_reg_size_t reg_size,
+                                     uint16_t reg,
+                                     uint8_t *chunk,
+                                     size_t chunk_size,
+                                     stwi_consumer_t consumer,
+                                     void *ctx);
+
+/* Perform operations as one transaction: they are separated by repeated start conditions
+ * and only the last one is followed by stop condition.
+ * An operation that continues the previous one of the same direction at the next register
+ * of the same device (register address auto-increment) is transferred without start
+ * condition and address bytes; a read without register doesn't send address with WRITE bit.
+ * The result of each operation is written to 'res', the stage of completed operations
+ * except the last one is STWI_STAGE_DATA. The batch is aborted at the first error.
+ * Returns number of operations whose results were written. */
+size_t stwi_dev_batch(struct stwi const *bus,
+                      struct stwi_op const *ops,
+                      size_t count,
+                      struct stwi_res *res);
+
+/* Transfer messages as one transaction like the Linux I2C_RDWR: each message starts with
+ * a (repeated) start condition and the address byte, unless it has STWI_M_NOSTART flag,
+ * and only the last one is followed by stop condition.
+ * The last byte of a read message is acknowledged if the next one continues reading.
+ * The 'len' of messages with STWI_M_RECV_LEN is updated with the received count, a count
+ * of 0 or above STWI_M_RECV_LEN_MAX gets NACK, stop condition and STWI_ERR_SIZE.
+ * The result 'data_size' is the number of messages transferred completely,
+ * the transfer is aborted at the first error. */
+struct stwi_res stwi_transfer(struct stwi const *bus, struct stwi_msg *msgs, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* SOFTBUS_STWI_H */
@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2020 Oleg Dolgy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Software implementation of Two Wire Interface (header-only C++20 front end).
+ *
+ * Pin operations are supplied by policy types as static functions, so the compiler
+ * can inline them instead of calling through the function pointers of 'struct stwi'.
+ * The generated waveforms are the same as those of the C functions in "stwi.h".
+ *
+ * Pins policy:
+ *   static void write_scl(stwi_pin_state_t state);
+ *   static void write_sda(stwi_pin_state_t state);
+ *   static stwi_pin_state_t read_scl();  (not required if clock stretching is disabled)
+ *   static stwi_pin_state_t read_sda();
+ *   static constexpr bool stretch = false;  (optional, disables clock stretching)
+ * Delay policy:
+ *   static void delay();  (quarter period of the clock frequency)
+ * Timeout policy (not required if clock stretching is disabled):
+ *   static void start();
+ *   static bool check();
+ *
+ * The bus template is placed into namespace 'softbus', the C declarations of "stwi.h" stay
+ * global, so the other headers of the library can be used in the same translation unit:
+ *
+ *     using bus = softbus::stwi_bus<pins, delay, timeout>;
+ *     struct stwi_res res = bus::dev_write(0x25, STWI_REG_8, 0x10, data);
+ *
+ */
+
+#ifndef SOFTBUS_STWI_HPP
+#define SOFTBUS_STWI_HPP
+
+#include <span>
+#include "stwi.h"
+
+namespace softbus
+{
+
+namespace detail
+{
+/* Clock stretching is enabled unless the pins policy disables it */
+template <class Pins>
+constexpr bool stretch_enabled()
+{
+    if constexpr (requires { Pins::stretch; })
+    {
+        return Pins::stretch;
+    }
+    else
+    {
+        return true;
+    }
+}
+} // namespace detail
+
+/* Software TWI bus */
+template <class Pins, class Delay, class Timeout>
+struct stwi_bus
+{
+    /* Whether clock stretching is supported */
+    static constexpr bool stretch = detail::stretch_enabled<Pins>();
+
+    /* Wait until slave device releases SCL line (clock stretch) */
+    static ::stwi_err_t stretch_wait()
+    {
+        if constexpr (stretch)
+        {
+            if (Pins::read_scl() == STWI_PIN_LOW)
+            {
+                Timeout::start();
+                do
+                {
+                    STWI_ASSERT(Timeout::check(), return STWI_ERR_STRETCH;);
+                    Delay::delay();
+                } while (Pins::read_scl() == STWI_PIN_LOW);
+            }
+        }
+        return STWI_ERR_OK;
+    }
+
+    /* Generate clock pulse and send one bit */
+    static ::stwi_err_t write_bit(::stwi_pin_state_t bit)
+    {
+        ::stwi_err_t err;
+        Pins::write_sda(bit);
+        Delay::delay();
+        Pins::write_scl(STWI_PIN_HIGH);
+        Delay::delay();
+        STWI_ASSERT(!(err = stretch_wait()), return err;);
+        Delay::delay();
+        Pins::write_scl(STWI_PIN_LOW);
+        Delay::delay();
+        return STWI_ERR_OK;
+    }
+
+    /* Generate clock pulse and receive one bit */
+    static ::stwi_err_t read_bit(::stwi_pin_state_t &bit)
+    {
+        ::stwi_err_t err;
+        Pins::write_sda(STWI_PIN_HIGH);
+        Delay::delay();
+        Pins::write_scl(STWI_PIN_HIGH);
+        Delay::delay();
+        STWI_ASSERT(!(err = stretch_wait()), return err;);
+        Delay::delay();
+        bit = Pins::read_sda();
+        Pins::write_scl(STWI_PIN_LOW);
+        Delay::delay();
+        return STWI_ERR_OK;
+    }
+
+    /* Generate start or repeated start condition */
+    static ::stwi_err_t start()
+    {
+        ::stwi_err_t err;
+        /* Release lines (necessary for repeated start) */
+        Pins::write_sda(STWI_PIN_HIGH);
+        Delay::delay();
+        Pins::write_scl(STWI_PIN_HIGH);
+        Delay::delay();
+        STWI_ASSERT(!(err = stretch_wait()), return err;);
+        /* Generate start */
+        Pins::write_sda(STWI_PIN_LOW);
+        Delay::delay();
+        Pins::write_scl(STWI_PIN_LOW);
+        Delay::delay();
+        return STWI_ERR_OK;
+    }
+
+    /* Generate stop condition */
+    static ::stwi_err_t stop()
+    {
+        ::stwi_err_t err;
+        Pins::write_sda(STWI_PIN_LOW);
+        Delay::delay();
+        Pins::write_scl(STWI_PIN_HIGH);
+        Delay::delay();
+        STWI_ASSERT(!(err = stretch_wait()), return err;);
+        Pins::write_sda(STWI_PIN_HIGH);
+        Delay::delay();
+        return STWI_ERR_OK;
+    }
+
+    /* Send one byte and receive ACK or NACK bit */
+    static ::stwi_err_t write_byte(uint8_t byte)
+    {
+        ::stwi_err_t err;
+        /* Send byte */
+        for (int i = 0; i < 8; i++)
+        {
+            err = write_bit((byte & 0x80) ? STWI_PIN_HIGH : STWI_PIN_LOW);
+            STWI_ASSERT(!err, return err;);
+            byte <<= 1;
+        }
+        /* Receive ACK or NACK bit */
+        ::stwi_pin_state_t bit;
+        STWI_ASSERT(!(err = read_bit(bit)), return err;);
+        return (bit == STWI_PIN_LOW) ? STWI_ERR_OK : STWI_ERR_NACK;
+    }
+
+    /* Receive one byte and send ACK or NACK bit */
+    static ::stwi_err_t read_byte(uint8_t &byte, bool ack)
+    {
+        ::stwi_err_t err;
+        uint8_t data = 0;
+        /* Receive byte */
+        for (int i = 0; i < 8; i++)
+        {
+            ::stwi_pin_state_t bit;
+            STWI_ASSERT(!(err = read_bit(bit)), return err;);
+            data = data << 1 | ((bit == STWI_PIN_HIGH) ? 0x01 : 0x00);
+        }
+        /* Send ACK or NACK bit */
+        STWI_ASSERT(!(err = write_bit(ack ? STWI_PIN_LOW : STWI_PIN_HIGH)), return err;);
+        byte = data;
+        return STWI_ERR_OK;
+    }
+
+    /* Send data array to the specified register of the device with 7-bit address */
+    static ::stwi_res dev_write(uint8_t addr,
+                                ::stwi_reg_size_t reg_size,
+                                uint16_t reg,
+                                std::span<uint8_t const> data)
+    {
+        ::stwi_res res = {};
+        STWI_ASSERT(!dev_addr(res, addr, reg_size, reg), return res;);
+        /* Send data */
+        res.stage = STWI_STAGE_DATA;
+        for (uint8_t byte : data)
+        {
+            STWI_ASSERT(!(res.err = write_byte(byte)), return res;);
+            res.data_size++;
+        }
+        /* Generate stop condition */
+        res.stage = STWI_STAGE_STOP;
+        STWI_ASSERT(!(res.err = stop()), return res;);
+        return res;
+    }
+
+    /* Receive data array from the specified register of the device with 7-bit address */
+    static ::stwi_res dev_read(uint8_t addr,
+                               ::stwi_reg_size_t reg_size,
+                               uint16_t reg,
+                               std::span<uint8_t> data)
+    {
+        ::stwi_res res = {};
+        STWI_ASSERT(!dev_addr(res, addr, reg_size, reg), return res;);
+        /* Generate repeated start */
+        res.stage = STWI_STAGE_START;
+        STWI_ASSERT(!(res.err = start()), return res;);
+        /* Send device address with READ bit */
+        res.stage = STWI_STAGE_ADDR;
+        STWI_ASSERT(!(res.err = write_byte(addr << 1 | 0x01)), return res;);
+        /* Receive data */
+        res.stage = STWI_STAGE_DATA;
+        for (size_t i = 0; i < data.size(); i++)
+        {
+            STWI_ASSERT(!(res.err = read_byte(data[i], i + 1 < data.size())), return res;);
+            res.data_size++;
+        }
+        /* Generate stop condition */
+        res.stage = STWI_STAGE_STOP;
+        STWI_ASSERT(!(res.err = stop()), return res;);
+        return res;
+    }
+
+private:
+    /* Generate start condition, send device address with WRITE bit and register address */
+    static ::stwi_err_t dev_addr(::stwi_res &res, uint8_t addr, ::stwi_reg_size_t reg_size, uint16_t reg)
+    {
+        /* Generate start condition */
+        res.stage = STWI_STAGE_START;
+        STWI_ASSERT(!(res.err = start()), return res.err;);
+        /* Send device address with WRITE bit */
+        res.stage = STWI_STAGE_ADDR;
+        STWI_ASSERT(!(res.err = write_byte(addr << 1 | 0x00)), return res.err;);
+        /* Send register high byte */
+        res.stage = STWI_STAGE_REG;
+        if (reg_size == STWI_REG_16)
+        {
+            STWI_ASSERT(!(res.err = write_byte(reg >> 8 & 0xFF)), return res.err;);
+        }
+        /* Send register low byte */
+        if (reg_size != STWI_REG_0)
+        {
+            STWI_ASSERT(!(res.err = write_byte(reg & 0xFF)), return res.err;);
+        }
+        return STWI_ERR_OK;
+    }
+};
+
+} // namespace softbus
+
+#endif /* SOFTBUS_STWI_HPP */
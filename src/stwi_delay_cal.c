@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2020 Oleg Dolgy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Calibrated delay backend for Software Two Wire Interface.
+ *
+ */
+
+#include "stwi_delay_cal.h"
+
+void stwi_delay_cal_init(struct stwi_delay_cal *cal,
+                         uint32_t (*ticks)(struct stwi_delay_cal const *cal),
+                         uint32_t quarter)
+{
+    *cal = (struct stwi_delay_cal){
+        .ticks = ticks,
+        .quarter = quarter,
+    };
+}
+
+uint32_t stwi_delay_calibrate(struct stwi_delay_cal *cal, struct stwi const *bus, uint8_t addr)
+{
+    cal->overhead = 0;
+    cal->sum = 0;
+    cal->calls = 0;
+    for (unsigned i = 0; i < STWI_DELAY_CAL_PROBES; i++)
+    {
+        /* Bits of the address byte are measured, they make up most of the transfer time.
+         * Stop condition follows the address at once, no data reaches a device. */
+        uint32_t sum = cal->sum;
+        uint32_t calls = cal->calls;
+        STWI_ASSERT(!stwi_start(bus), continue;);
+        cal->calibrating = true;
+        cal->started = false;
+        stwi_err_t err = stwi_write_byte(bus, addr << 1 | 0x00);
+        cal->calibrating = false;
+        stwi_stop(bus);
+        /* The probe addressed by a device or stretched is discarded */
+        STWI_ASSERT(err == STWI_ERR_NACK, cal->sum = sum; cal->calls = calls;);
+    }
+    if (cal->calls) { cal->overhead = (cal->sum + cal->calls / 2) / cal->calls; }
+    return cal->overhead;
+}
+
+void stwi_delay_cal_wait(struct stwi_delay_cal *cal, unsigned n)
+{
+    uint32_t start = cal->ticks(cal);
+    if (cal->calibrating)
+    {
+        /* Everything since the previous call except the requested wait is overhead */
+        if (cal->started)
+        {
+            cal->sum += start - cal->start - cal->wait;
+            cal->calls++;
+        }
+        cal->started = true;
+        cal->start = start;
+    }
+    uint32_t wait = n * cal->quarter;
+    wait = (wait > cal->overhead) ? wait - cal->overhead : 0;
+    cal->wait = wait;
+    while (cal->ticks(cal) - start < wait) {}
+}
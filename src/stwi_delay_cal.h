@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2020 Oleg Dolgy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Calibrated delay backend for Software Two Wire Interface.
+ *
+ * The driver spends time in pin callbacks and its own code between delays, so waiting for
+ * the whole quarter period makes the clock slower than configured. The backend measures
+ * that overhead per delay call with a cycle or timestamp counter while short probes are sent
+ * and waits for the rest of the quarter period only:
+ *
+ *     static void delay(struct stwi const *bus) { stwi_delay_cal_wait(&cal, 1); }
+ *     static void delay_n(struct stwi const *bus, unsigned n) { stwi_delay_cal_wait(&cal, n); }
+ *     ...
+ *     stwi_delay_cal_init(&cal, ticks, F_CPU / 400000);
+ *     stwi_delay_calibrate(&cal, &bus, 0x7F);
+ *
+ * The overhead is averaged over all phases of a bit, so the clock period is compensated
+ * while the phases may keep a small skew. The counter may wrap around.
+ *
+ */
+
+#ifndef SOFTBUS_STWI_DELAY_CAL_H
+#define SOFTBUS_STWI_DELAY_CAL_H
+
+#include "stwi.h"
+
+/* Number of probes of the calibration */
+#define STWI_DELAY_CAL_PROBES 8
+
+/* Calibrated delay */
+struct stwi_delay_cal
+{
+    /* Get current value of the counter */
+    uint32_t (*ticks)(struct stwi_delay_cal const *cal);
+    /* Quarter period of the clock in counter ticks */
+    uint32_t quarter;
+    /* Measured overhead per delay call in ticks */
+    uint32_t overhead;
+    /* Internal state: calibration is running, start and length of the last wait,
+     * total overhead and number of measured calls */
+    bool calibrating;
+    bool started;
+    uint32_t start;
+    uint32_t wait;
+    uint32_t sum;
+    uint32_t calls;
+};
+
+/* Initialize delay without overhead compensation */
+void stwi_delay_cal_init(struct stwi_delay_cal *cal,
+                         uint32_t (*ticks)(struct stwi_delay_cal const *cal),
+                         uint32_t quarter);
+
+/* Measure the overhead with STWI_DELAY_CAL_PROBES address bytes sent to an absent device,
+ * each followed by stop condition. Probes acknowledged by a device are not measured.
+ * The bus delay callbacks must use 'cal'. Returns the overhead per delay call in ticks. */
+uint32_t stwi_delay_calibrate(struct stwi_delay_cal *cal, struct stwi const *bus, uint8_t addr);
+
+/* Wait for 'n' quarter periods minus the overhead, to be called by the bus delay callbacks */
+void stwi_delay_cal_wait(struct stwi_delay_cal *cal, unsigned n);
+
+#endif /* SOFTBUS_STWI_DELAY_CAL_H */
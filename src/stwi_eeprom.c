@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2020 Oleg Dolgy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * 24Cxx series EEPROM driver on top of Software Two Wire Interface.
+ *
+ */
+
+#include "stwi_eeprom.h"
+
+/* Get device address for the memory address */
+static uint8_t stwi_eeprom_dev_addr(struct stwi_eeprom const *eeprom, uint16_t mem_addr)
+{
+    return (eeprom->reg_size == STWI_REG_8) ? (eeprom->addr | (mem_addr >> 8 & 0x07)) : eeprom->addr;
+}
+
+/* Generate start condition and send device address with WRITE bit until the chip
+ * acknowledges it, then send the memory address */
+static stwi_err_t stwi_eeprom_addr(struct stwi_eeprom const *eeprom, uint16_t mem_addr, struct stwi_res *res)
+{
+    struct stwi const *bus = eeprom->bus;
+    uint8_t addr = stwi_eeprom_dev_addr(eeprom, mem_addr);
+    stwi_dev_select(bus, addr);
+    for (size_t probe = 0;; probe++)
+    {
+        /* Generate start condition (repeated start for the next probe) */
+        res->stage = STWI_STAGE_START;
+        STWI_ASSERT(!(res->err = stwi_start(bus)), return res->err;);
+        /* Send device address with WRITE bit */
+        res->stage = STWI_STAGE_ADDR;
+        res->err = stwi_write_byte(bus, addr << 1 | 0x00);
+        if (res->err != STWI_ERR_NACK) { break; }
+        STWI_ASSERT(probe < eeprom->poll_max, return res->err;);
+    }
+    STWI_ASSERT(!res->err, return res->err;);
+    /* Send memory address */
+    res->stage = STWI_STAGE_REG;
+    if (eeprom->reg_size == STWI_REG_16)
+    {
+        STWI_ASSERT(!(res->err = stwi_write_byte(bus, mem_addr >> 8 & 0xFF)), return res->err;);
+    }
+    STWI_ASSERT(!(res->err = stwi_write_byte(bus, mem_addr & 0xFF)), return res->err;);
+    return STWI_ERR_OK;
+}
+
+bool stwi_eeprom_init(struct stwi_eeprom *eeprom,
+                      struct stwi const *bus,
+                      uint8_t addr,
+                      stwi_reg_size_t reg_size,
+                      uint16_t page_size,
+                      size_t poll_max)
+{
+    /* Writes are split at page boundaries */
+    STWI_ASSERT(page_size, return false;);
+    *eeprom = (struct stwi_eeprom){
+        .bus = bus,
+        .addr = addr,
+        .reg_size = reg_size,
+        .page_size = page_size,
+        .poll_max = poll_max,
+    };
+    return true;
+}
+
+struct stwi_res stwi_eeprom_write(struct stwi_eeprom const *eeprom,
+                                  uint16_t mem_addr,
+                                  uint8_t const *buff,
+                                  size_t size)
+{
+    struct stwi const *bus = eeprom->bus;
+    struct stwi_res res = {};
+    while (res.data_size < size)
+    {
+        /* Write up to the page boundary */
+        size_t page_left = eeprom->page_size - mem_addr % eeprom->page_size;
+        size_t page_end = res.data_size + ((size - res.data_size < page_left) ? size - res.data_size : page_left);
+        STWI_ASSERT(!stwi_eeprom_addr(eeprom, mem_addr, &res), return res;);
+        /* Send data */
+        res.stage = STWI_STAGE_DATA;
+        for (; res.data_size < page_end; res.data_size++, mem_addr++)
+        {
+            STWI_ASSERT(!(res.err = stwi_write_byte(bus, buff[res.data_size])), return res;);
+        }
+        /* Generate stop condition, it starts the internal write cycle */
+        res.stage = STWI_STAGE_STOP;
+        STWI_ASSERT(!(res.err = stwi_stop(bus)), return res;);
+    }
+    return res;
+}
+
+struct stwi_res stwi_eeprom_read(struct stwi_eeprom const *eeprom,
+                                 uint16_t mem_addr,
+                                 uint8_t *buff,
+                                 size_t size)
+{
+    struct stwi const *bus = eeprom->bus;
+    struct stwi_res res = {};
+    STWI_ASSERT(!stwi_eeprom_addr(eeprom, mem_addr, &res), return res;);
+    /* Generate repeated start */
+    res.stage = STWI_STAGE_START;
+    STWI_ASSERT(!(res.err = stwi_start(bus)), return res;);
+    /* Send device address with READ bit */
+    res.stage = STWI_STAGE_ADDR;
+    STWI_ASSERT(!(res.err = stwi_write_byte(bus, stwi_eeprom_dev_addr(eeprom, mem_addr) << 1 | 0x01)),
+                return res;);
+    /* Receive data, sequential read continues over the whole memory */
+    res.stage = STWI_STAGE_DATA;
+    for (; res.data_size < size; res.data_size++)
+    {
+        STWI_ASSERT(!(res.err = stwi_read_byte(bus, &buff[res.data_size], res.data_size + 1 < size)),
+                    return res;);
+    }
+    /* Generate stop condition */
+    res.stage = STWI_STAGE_STOP;
+    STWI_ASSERT(!(res.err = stwi_stop(bus)), return res;);
+    return res;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2020 Oleg Dolgy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * 24Cxx series EEPROM driver on top of Software Two Wire Interface.
+ *
+ * Writes are split at page boundaries. After a page is written the chip doesn't
+ * acknowledge its address until the internal write cycle is complete, so instead of
+ * waiting for the maximum write time the address is probed (ACK polling) and the next
+ * page is sent right after the probe that has been acknowledged.
+ *
+ */
+
+#ifndef SOFTBUS_STWI_EEPROM_H
+#define SOFTBUS_STWI_EEPROM_H
+
+#include "stwi.h"
+
+/* EEPROM handle */
+struct stwi_eeprom
+{
+    struct stwi const *bus;
+    /* 7-bit device address */
+    uint8_t addr;
+    /* Word address size: STWI_REG_8 for 24C01-24C16 (bits 8-10 of the memory address are
+     * sent in the device address), STWI_REG_16 for larger chips */
+    stwi_reg_size_t reg_size;
+    /* Page size in bytes (non-zero) */
+    uint16_t page_size;
+    /* Number of address probes repeated while the chip is busy, before giving up */
+    size_t poll_max;
+};
+
+/* Initialize EEPROM handle. Returns false if the page size is zero. */
+bool stwi_eeprom_init(struct stwi_eeprom *eeprom,
+                      struct stwi const *bus,
+                      uint8_t addr,
+                      stwi_reg_size_t reg_size,
+                      uint16_t page_size,
+                      size_t poll_max);
+
+/* Write data array to the memory. Data size of the result counts bytes across all pages. */
+struct stwi_res stwi_eeprom_write(struct stwi_eeprom const *eeprom,
+                                  uint16_t mem_addr,
+                                  uint8_t const *buff,
+                                  size_t size);
+
+/* Read data array from the memory, waiting for completion of the previous write */
+struct stwi_res stwi_eeprom_read(struct stwi_eeprom const *eeprom,
+                                 uint16_t mem_addr,
+                                 uint8_t *buff,
+                                 size_t size);
+
+#endif /* SOFTBUS_STWI_EEPROM_H */
@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2020 Oleg Dolgy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Software implementation of Two Wire Interface for several buses sharing one GPIO port.
+ *
+ */
+
+#include "stwi_multi.h"
+
+/* Convert the same byte of all lanes to bit slices */
+static void stwi_multi_slice(uint8_t byte, uint32_t slices[8])
+{
+    for (int i = 0; i < 8; i++)
+    {
+        slices[i] = (byte & (0x80 >> i)) ? UINT32_MAX : 0;
+    }
+}
+
+/* Update results of the lanes that failed since the previous call */
+static void stwi_multi_settle(struct stwi_multi_lanes const *st,
+                              uint32_t *lanes,
+                              stwi_stage_t stage,
+                              size_t data_size,
+                              struct stwi_res *res)
+{
+    uint32_t failed = *lanes & ~st->active;
+    for (int lane = 0; failed; lane++, failed >>= 1)
+    {
+        if (failed & 0x01)
+        {
+            res[lane].err = (st->stretch >> lane & 0x01) ? STWI_ERR_STRETCH : STWI_ERR_NACK;
+            res[lane].stage = stage;
+            res[lane].data_size = data_size;
+        }
+    }
+    *lanes = st->active;
+}
+
+/* Generate start condition and send device and register addresses */
+static void stwi_multi_dev_addr(struct stwi_multi const *bus,
+                                struct stwi_multi_lanes *st,
+                                uint32_t *lanes,
+                                uint8_t addr,
+                                stwi_reg_size_t reg_size,
+                                uint16_t reg,
+                                struct stwi_res *res)
+{
+    uint32_t slices[8];
+    /* Generate start condition */
+    stwi_multi_start(bus, st);
+    stwi_multi_settle(st, lanes, STWI_STAGE_START, 0, res);
+    STWI_ASSERT(st->active, return;);
+    /* Send device address with WRITE bit */
+    stwi_multi_slice(addr << 1 | 0x00, slices);
+    stwi_multi_write_byte(bus, st, slices);
+    stwi_multi_settle(st, lanes, STWI_STAGE_ADDR, 0, res);
+    STWI_ASSERT(st->active, return;);
+    /* Send register high byte */
+    if (reg_size == STWI_REG_16)
+    {
+        stwi_multi_slice(reg >> 8 & 0xFF, slices);
+        stwi_multi_write_byte(bus, st, slices);
+        stwi_multi_settle(st, lanes, STWI_STAGE_REG, 0, res);
+        STWI_ASSERT(st->active, return;);
+    }
+    /* Send register low byte */
+    if (reg_size != STWI_REG_0)
+    {
+        stwi_multi_slice(reg & 0xFF, slices);
+        stwi_multi_write_byte(bus, st, slices);
+        stwi_multi_settle(st, lanes, STWI_STAGE_REG, 0, res);
+    }
+}
+
+void stwi_multi_dev_write(struct stwi_multi const *bus,
+                          uint32_t lanes,
+                          uint8_t addr,
+                          stwi_reg_size_t reg_size,
+                          uint16_t reg,
+                          uint8_t const *const *buffs,
+                          size_t size,
+                          struct stwi_res *res)
+{
+    struct stwi_multi_lanes st = stwi_multi_lanes_new(lanes);
+    uint32_t slices[8];
+    stwi_multi_dev_addr(bus, &st, &lanes, addr, reg_size, reg, res);
+    /* Send data */
+    for (size_t i = 0; i < size && st.active; i++)
+    {
+        for (int bit = 0; bit < 8; bit++)
+        {
+            slices[bit] = 0;
+        }
+        for (int lane = 0; lane < STWI_MULTI_LANES; lane++)
+        {
+            if (!(st.active >> lane & 0x01)) continue;
+            uint8_t byte = buffs[lane][i];
+            for (int bit = 0; bit < 8; bit++)
+            {
+                slices[bit] |= (uint32_t)(byte >> (7 - bit) & 0x01) << lane;
+            }
+        }
+        stwi_multi_write_byte(bus, &st, slices);
+        stwi_multi_settle(&st, &lanes, STWI_STAGE_DATA, i, res);
+    }
+    /* Generate stop condition */
+    if (st.active)
+    {
+        stwi_multi_stop(bus, &st);
+        stwi_multi_settle(&st, &lanes, STWI_STAGE_STOP, size, res);
+    }
+    /* Lanes without errors */
+    for (int lane = 0; lanes; lane++, lanes >>= 1)
+    {
+        if (lanes & 0x01)
+        {
+            res[lane] = (struct stwi_res){.err = STWI_ERR_OK, .stage = STWI_STAGE_STOP, .data_size = size};
+        }
+    }
+}
+
+void stwi_multi_dev_read(struct stwi_multi const *bus,
+                         uint32_t lanes,
+                         uint8_t addr,
+                         stwi_reg_size_t reg_size,
+                         uint16_t reg,
+                         uint8_t *const *buffs,
+                         size_t size,
+                         struct stwi_res *res)
+{
+    struct stwi_multi_lanes st = stwi_multi_lanes_new(lanes);
+    uint32_t slices[8];
+    stwi_multi_dev_addr(bus, &st, &lanes, addr, reg_size, reg, res);
+    /* Generate repeated start */
+    if (st.active)
+    {
+        stwi_multi_start(bus, &st);
+        stwi_multi_settle(&st, &lanes, STWI_STAGE_START, 0, res);
+    }
+    /* Send device address with READ bit */
+    if (st.active)
+    {
+        stwi_multi_slice(addr << 1 | 0x01, slices);
+        stwi_multi_write_byte(bus, &st, slices);
+        stwi_multi_settle(&st, &lanes, STWI_STAGE_ADDR, 0, res);
+    }
+    /* Receive data */
+    for (size_t i = 0; i < size && st.active; i++)
+    {
+        stwi_multi_read_byte(bus, &st, slices, (i + 1 < size) ? UINT32_MAX : 0);
+        /* Lanes that failed during ACK bit have received the byte but it doesn't count */
+        stwi_multi_settle(&st, &lanes, STWI_STAGE_DATA, i, res);
+        for (int lane = 0; lane < STWI_MULTI_LANES; lane++)
+        {
+            if (!(st.active >> lane & 0x01)) continue;
+            uint8_t byte = 0;
+            for (int bit = 0; bit < 8; bit++)
+            {
+                byte = byte << 1 | (slices[bit] >> lane & 0x01);
+            }
+            buffs[lane][i] = byte;
+        }
+    }
+    /* Generate stop condition */
+    if (st.active)
+    {
+        stwi_multi_stop(bus, &st);
+        stwi_multi_settle(&st, &lanes, STWI_STAGE_STOP, size, res);
+    }
+    /* Lanes without errors */
+    for (int lane = 0; lanes; lane++, lanes >>= 1)
+    {
+        if (lanes & 0x01)
+        {
+            res[lane] = (struct stwi_res){.err = STWI_ERR_OK, .stage = STWI_STAGE_STOP, .data_size = size};
+        }
+    }
+}
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2020 Oleg Dolgy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Software implementation of Two Wire Interface for several buses sharing one GPIO port.
+ * Every bus is a bit lane: bit N of the port words corresponds to the bus N.
+ *
+ */
+
+#ifndef SOFTBUS_STWI_MULTI_H
+#define SOFTBUS_STWI_MULTI_H
+
+#include "stwi.h"
+
+/* Maximum number of lanes */
+#define STWI_MULTI_LANES 32
+
+/* Software TWI multi-bus handle */
+struct stwi_multi
+{
+    /* Set states of SCL and SDA lines of all lanes */
+    void (*write_port)(struct stwi_multi const *bus, uint32_t scl, uint32_t sda);
+    /* Get states of SCL and SDA lines of all lanes */
+    void (*read_port)(struct stwi_multi const *bus, uint32_t *scl, uint32_t *sda);
+    /* Wait for a period equals to the quarter period of the clock frequency */
+    void (*delay)(struct stwi_multi const *bus);
+    /* Start timeout timer for clock stretching */
+    void (*timeout_start)(struct stwi_multi const *bus);
+    /* Check whether clock stretching timeout is not expired */
+    bool (*timeout_check)(struct stwi_multi const *bus);
+};
+
+/* State of the lanes during an operation */
+struct stwi_multi_lanes
+{
+    /* Output states of SCL lines */
+    uint32_t scl;
+    /* Output states of SDA lines */
+    uint32_t sda;
+    /* Lanes without errors. Other lanes keep their output states. */
+    uint32_t active;
+    /* Lanes with clock stretch timeout */
+    uint32_t stretch;
+    /* Lanes that received NACK */
+    uint32_t nack;
+};
+
+/* Get idle state of the specified lanes */
+static inline struct stwi_multi_lanes stwi_multi_lanes_new(uint32_t lanes)
+{
+    return (struct stwi_multi_lanes){
+        .scl = UINT32_MAX,
+        .sda = UINT32_MAX,
+        .active = lanes,
+    };
+}
+
+/* Set states of the active lanes */
+static inline void stwi_multi_write(struct stwi_multi const *bus,
+                                    struct stwi_multi_lanes *st,
+                                    uint32_t scl,
+                                    uint32_t sda)
+{
+    st->scl = (st->scl & ~st->active) | (scl & st->active);
+    st->sda = (st->sda & ~st->active) | (sda & st->active);
+    bus->write_port(bus, st->scl, st->sda);
+}
+
+/* Wait until slave devices release SCL lines (clock stretch) */
+static inline void stwi_multi_stretch_wait(struct stwi_multi const *bus, struct stwi_multi_lanes *st)
+{
+    uint32_t scl, sda;
+    bus->read_port(bus, &scl, &sda);
+    uint32_t low = ~scl & st->active;
+    if (low)
+    {
+        bus->timeout_start(bus);
+        do
+        {
+            STWI_ASSERT(bus->timeout_check(bus), st->stretch |= low; st->active &= ~low; return;);
+            bus->delay(bus);
+            bus->read_port(bus, &scl, &sda);
+            low = ~scl & st->active;
+        } while (low);
+    }
+}
+
+/* Generate clock pulse and send one bit on every lane */
+static inline void stwi_multi_write_bit(struct stwi_multi const *bus,
+                                        struct stwi_multi_lanes *st,
+                                        uint32_t bits)
+{
+    stwi_multi_write(bus, st, st->scl, bits);
+    bus->delay(bus);
+    stwi_multi_write(bus, st, UINT32_MAX, st->sda);
+    bus->delay(bus);
+    stwi_multi_stretch_wait(bus, st);
+    bus->delay(bus);
+    stwi_multi_write(bus, st, 0, st->sda);
+    bus->delay(bus);
+}
+
+/* Generate clock pulse and receive one bit from every lane */
+static inline void stwi_multi_read_bit(struct stwi_multi const *bus,
+                                       struct stwi_multi_lanes *st,
+                                       uint32_t *bits)
+{
+    uint32_t scl;
+    stwi_multi_write(bus, st, st->scl, UINT32_MAX);
+    bus->delay(bus);
+    stwi_multi_write(bus, st, UINT32_MAX, st->sda);
+    bus->delay(bus);
+    stwi_multi_stretch_wait(bus, st);
+    bus->delay(bus);
+    bus->read_port(bus, &scl, bits);
+    stwi_multi_write(bus, st, 0, st->sda);
+    bus->delay(bus);
+}
+
+/* Generate start or repeated start condition on every lane */
+static inline void stwi_multi_start(struct stwi_multi const *bus, struct stwi_multi_lanes *st)
+{
+    /* Release lines (necessary for repeated start) */
+    stwi_multi_write(bus, st, st->scl, UINT32_MAX);
+    bus->delay(bus);
+    stwi_multi_write(bus, st, UINT32_MAX, st->sda);
+    bus->delay(bus);
+    stwi_multi_stretch_wait(bus, st);
+    /* Generate start */
+    stwi_multi_write(bus, st, st->scl, 0);
+    bus->delay(bus);
+    stwi_multi_write(bus, st, 0, st->sda);
+    bus->delay(bus);
+}
+
+/* Generate stop condition on every lane */
+static inline void stwi_multi_stop(struct stwi_multi const *bus, struct stwi_multi_lanes *st)
+{
+    stwi_multi_write(bus, st, st->scl, 0);
+    bus->delay(bus);
+    stwi_multi_write(bus, st, UINT32_MAX, st->sda);
+    bus->delay(bus);
+    stwi_multi_stretch_wait(bus, st);
+    stwi_multi_write(bus, st, st->scl, UINT32_MAX);
+    bus->delay(bus);
+}
+
+/* Send one byte on every lane and receive ACK or NACK bits.
+ * Bit-sliced byte: slices[0] holds the most significant bits of all lanes. */
+static inline void stwi_multi_write_byte(struct stwi_multi const *bus,
+                                         struct stwi_multi_lanes *st,
+                                         uint32_t const slices[8])
+{
+    /* Send byte */
+    for (int i = 0; i < 8; i++)
+    {
+        stwi_multi_write_bit(bus, st, slices[i]);
+    }
+    /* Receive ACK or NACK bits */
+    uint32_t bits;
+    stwi_multi_read_bit(bus, st, &bits);
+    st->nack |= bits & st->active;
+    st->active &= ~bits;
+}
+
+/* Receive one byte from every lane and send ACK (bit is set) or NACK (bit is reset) bits */
+static inline void stwi_multi_read_byte(struct stwi_multi const *bus,
+                                        struct stwi_multi_lanes *st,
+                                        uint32_t slices[8],
+                                        uint32_t ack)
+{
+    /* Receive byte */
+    for (int i = 0; i < 8; i++)
+    {
+        stwi_multi_read_bit(bus, st, &slices[i]);
+    }
+    /* Send ACK or NACK bits */
+    stwi_multi_write_bit(bus, st, ~ack);
+}
+
+/* Send data arrays to the specified register of the devices with 7-bit address.
+ * Arrays 'buffs' and 'res' are indexed by lane number. */
+void stwi_multi_dev_write(struct stwi_multi const *bus,
+                          uint32_t lanes,
+                          uint8_t addr,
+                          stwi_reg_size_t reg_size,
+                          uint16_t reg,
+                          uint8_t const *const *buffs,
+                          size_t size,
+                          struct stwi_res *res);
+
+/* Receive data arrays from the specified register of the devices with 7-bit address.
+ * Arrays 'buffs' and 'res' are indexed by lane number. */
+void stwi_multi_dev_read(struct stwi_multi const *bus,
+                         uint32_t lanes,
+                         uint8_t addr,
+                         stwi_reg_size_t reg_size,
+                         uint16_t reg,
+                         uint8_t *const *buffs,
+                         size_t size,
+                         struct stwi_res *res);
+
+#endif /* SOFTBUS_STWI_MULTI_H */
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2020 Oleg Dolgy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Register cache for devices with register map on top of Software Two Wire Interface.
+ *
+ */
+
+#include "stwi_regmap.h"
+
+/* Check whether the registers belong to the map */
+static bool stwi_regmap_contains(struct stwi_regmap const *map, uint16_t reg, size_t size)
+{
+    return reg >= map->base && reg - map->base <= map->count && size <= map->count - (reg - map->base);
+}
+
+/* Check whether the register has to be read from the device */
+static bool stwi_regmap_uncached(struct stwi_regmap const *map, size_t i)
+{
+    return (map->flags[i] & STWI_REGMAP_VOLATILE) || !(map->flags[i] & STWI_REGMAP_VALID);
+}
+
+struct stwi_res stwi_regmap_read(struct stwi_regmap const *map, uint16_t reg, uint8_t *buff, size_t size)
+{
+    STWI_ASSERT(stwi_regmap_contains(map, reg, size),
+                return stwi_dev_read(map->bus, map->addr, map->reg_size, reg, buff, size););
+    size_t offs = reg - map->base;
+    /* Find the span of registers to be read from the device */
+    size_t first = 0, last = size;
+    while (first < size && !stwi_regmap_uncached(map, offs + first)) { first++; }
+    while (last > first && !stwi_regmap_uncached(map, offs + last - 1)) { last--; }
+    /* Cached registers before the span are received even if the device read fails */
+    for (size_t i = 0; i < first; i++)
+    {
+        buff[i] = map->values[offs + i];
+    }
+    struct stwi_res res = {.stage = STWI_STAGE_STOP};
+    if (first < last)
+    {
+        res = stwi_dev_read(map->bus, map->addr, map->reg_size, reg + first, &buff[first], last - first);
+        res.data_size += first;
+        STWI_ASSERT(!res.err, return res;);
+    }
+    for (size_t i = first; i < size; i++)
+    {
+        uint8_t *flags = &map->flags[offs + i];
+        if (i >= last || (*flags & STWI_REGMAP_DIRTY))
+        {
+            /* Cached value (the device has a stale one if the register is dirty) */
+            buff[i] = map->values[offs + i];
+        }
+        else if (!(*flags & STWI_REGMAP_VOLATILE))
+        {
+            map->values[offs + i] = buff[i];
+            *flags |= STWI_REGMAP_VALID;
+        }
+    }
+    res.data_size = size;
+    return res;
+}
+
+void stwi_regmap_set(struct stwi_regmap const *map, uint16_t reg, uint8_t const *buff, size_t size)
+{
+    size_t offs = reg - map->base;
+    for (size_t i = offs; i < offs + size; i++, buff++)
+    {
+        if ((map->flags[i] & (STWI_REGMAP_VOLATILE | STWI_REGMAP_VALID)) != STWI_REGMAP_VALID ||
+            map->values[i] != *buff)
+        {
+            map->values[i] = *buff;
+            map->flags[i] |= STWI_REGMAP_VALID | STWI_REGMAP_DIRTY;
+        }
+    }
+}
+
+struct stwi_res stwi_regmap_flush(struct stwi_regmap const *map)
+{
+    struct stwi_res res = {.stage = STWI_STAGE_STOP};
+    size_t written = 0;
+    for (size_t i = 0; i < map->count;)
+    {
+        /* Find the next run of dirty registers */
+        if (!(map->flags[i] & STWI_REGMAP_DIRTY))
+        {
+            i++;
+            continue;
+        }
+        size_t end = i + 1;
+        while (end < map->count && (map->flags[end] & STWI_REGMAP_DIRTY)) { end++; }
+        res = stwi_dev_write(map->bus, map->addr, map->reg_size, map->base + i, &map->values[i], end - i);
+        /* Registers that were sent are clean */
+        for (size_t j = i; j < i + res.data_size; j++)
+        {
+            map->flags[j] &= ~STWI_REGMAP_DIRTY;
+        }
+        written += res.data_size;
+        res.data_size = written;
+        STWI_ASSERT(!res.err, return res;);
+        i = end;
+    }
+    res.data_size = written;
+    return res;
+}
+
+struct stwi_res stwi_regmap_write(struct stwi_regmap const *map, uint16_t reg, uint8_t const *buff, size_t size)
+{
+    STWI_ASSERT(stwi_regmap_contains(map, reg, size),
+                return stwi_dev_write(map->bus, map->addr, map->reg_size, reg, buff, size););
+    stwi_regmap_set(map, reg, buff, size);
+    return stwi_regmap_flush(map);
+}
+
+struct stwi_res stwi_regmap_update_bits(struct stwi_regmap const *map, uint16_t reg, uint8_t mask, uint8_t value)
+{
+    uint8_t byte;
+    struct stwi_res res = stwi_regmap_read(map, reg, &byte, 1);
+    STWI_ASSERT(!res.err, return res;);
+    byte = (byte & ~mask) | (value & mask);
+    return stwi_regmap_write(map, reg, &byte, 1);
+}
+
+void stwi_regmap_invalidate(struct stwi_regmap const *map)
+{
+    for (size_t i = 0; i < map->count; i++)
+    {
+        if (!(map->flags[i] & STWI_REGMAP_DIRTY)) { map->flags[i] &= ~STWI_REGMAP_VALID; }
+    }
+}
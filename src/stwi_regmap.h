@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2020 Oleg Dolgy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Register cache for devices with register map on top of Software Two Wire Interface.
+ *
+ * The map shadows a contiguous range of 8-bit registers in caller-owned arrays of values
+ * and flags. Reads of cached registers don't access the bus, writes only mark changed
+ * registers dirty, and dirty registers are written in bursts of contiguous registers
+ * (the device must auto-increment register address). Volatile registers (status,
+ * counters, FIFOs) are always read from the device and always written.
+ *
+ * Accesses outside the map range are passed to stwi_dev_read() or stwi_dev_write().
+ *
+ */
+
+#ifndef SOFTBUS_STWI_REGMAP_H
+#define SOFTBUS_STWI_REGMAP_H
+
+#include "stwi.h"
+
+/* Register flags */
+/* Register isn't cached */
+#define STWI_REGMAP_VOLATILE 0x01
+/* Cached value is known */
+#define STWI_REGMAP_VALID 0x02
+/* Cached value hasn't been written to the device */
+#define STWI_REGMAP_DIRTY 0x04
+
+/* Register map handle */
+struct stwi_regmap
+{
+    struct stwi const *bus;
+    /* 7-bit device address */
+    uint8_t addr;
+    stwi_reg_size_t reg_size;
+    /* First register of the map */
+    uint16_t base;
+    /* Number of registers */
+    size_t count;
+    /* Cached values, 'count' items */
+    uint8_t *values;
+    /* Register flags, 'count' items. Set STWI_REGMAP_VOLATILE for volatile registers and
+     * STWI_REGMAP_VALID for registers with known reset values, clear the others. */
+    uint8_t *flags;
+};
+
+/* Receive registers, only volatile and not cached ones are read from the device.
+ * A transfer without bus access has STWI_STAGE_STOP stage. */
+struct stwi_res stwi_regmap_read(struct stwi_regmap const *map, uint16_t reg, uint8_t *buff, size_t size);
+
+/* Change cached registers without bus access, registers with new values become dirty.
+ * The registers must belong to the map. */
+void stwi_regmap_set(struct stwi_regmap const *map, uint16_t reg, uint8_t const *buff, size_t size);
+
+/* Write dirty registers to the device in bursts.
+ * Data size of the result counts written registers. */
+struct stwi_res stwi_regmap_flush(struct stwi_regmap const *map);
+
+/* Change registers and write them if their values differ from the cached ones */
+struct stwi_res stwi_regmap_write(struct stwi_regmap const *map, uint16_t reg, uint8_t const *buff, size_t size);
+
+/* Change bits of the register specified by 'mask' (read-modify-write) */
+struct stwi_res stwi_regmap_update_bits(struct stwi_regmap const *map, uint16_t reg, uint8_t mask, uint8_t value);
+
+/* Forget cached values (e.g. after device reset), dirty registers are kept */
+void stwi_regmap_invalidate(struct stwi_regmap const *map);
+
+#endif /* SOFTBUS_STWI_REGMAP_H */
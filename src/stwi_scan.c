@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2020 Oleg Dolgy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Bus scan on top of Software Two Wire Interface.
+ *
+ */
+
+#include "stwi_scan.h"
+
+stwi_err_t stwi_scan(struct stwi const *bus,
+                     uint8_t first,
+                     uint8_t last,
+                     stwi_dir_t dir,
+                     uint32_t map[STWI_SCAN_WORDS])
+{
+    stwi_err_t err;
+    STWI_ASSERT(first <= last && first < 128, return STWI_ERR_OK;);
+    for (unsigned addr = first; addr <= last && addr < 128; addr++)
+    {
+        /* Generate start condition (repeated start for the next probe) */
+        stwi_dev_select(bus, addr);
+        STWI_ASSERT(!(err = stwi_start(bus)), return err;);
+        /* Send device address */
+        err = stwi_write_byte(bus, addr << 1 | ((dir == STWI_DIR_READ) ? 0x01 : 0x00));
+        STWI_ASSERT(err != STWI_ERR_STRETCH, return err;);
+        if (err == STWI_ERR_OK)
+        {
+            map[addr / 32] |= (uint32_t)1 << (addr % 32);
+            /* The device drives SDA after read probe, receive the byte and release it */
+            if (dir == STWI_DIR_READ)
+            {
+                uint8_t byte;
+                STWI_ASSERT(!(err = stwi_read_byte(bus, &byte, false)), return err;);
+            }
+        }
+    }
+    /* Generate stop condition */
+    return stwi_stop(bus);
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2020 Oleg Dolgy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Bus scan on top of Software Two Wire Interface.
+ *
+ * Every address is probed with start condition and address byte only, probes are chained
+ * with repeated start conditions and the scan ends with one stop condition. A write probe
+ * (quick write) doesn't transfer any data. Some devices misbehave on it (e.g. take it as
+ * a command), they can be probed with read probes (quick read): a device that acknowledges
+ * its address sends one byte, which is received with NACK to release SDA.
+ *
+ * A probe takes 10 clock periods, the whole range of 112 addresses is scanned in 2.8 ms
+ * at 400 kHz.
+ *
+ */
+
+#ifndef SOFTBUS_STWI_SCAN_H
+#define SOFTBUS_STWI_SCAN_H
+
+#include "stwi.h"
+
+/* Range of addresses that aren't reserved by the bus specification */
+#define STWI_SCAN_FIRST 0x08
+#define STWI_SCAN_LAST 0x77
+
+/* Number of words in the presence bitmap of 128 addresses */
+#define STWI_SCAN_WORDS 4
+
+/* Probe devices with 7-bit addresses from 'first' to 'last' with WRITE or READ bit, set bits
+ * of responding devices in the bitmap: bit 'addr % 32' of word 'addr / 32'. Other bits
+ * aren't changed. Returns an error if the bus is blocked by clock stretch. */
+stwi_err_t stwi_scan(struct stwi const *bus,
+                     uint8_t first,
+                     uint8_t last,
+                     stwi_dir_t dir,
+                     uint32_t map[STWI_SCAN_WORDS]);
+
+/* Check whether the device is marked in the bitmap */
+static inline bool stwi_scan_found(uint32_t const map[STWI_SCAN_WORDS], uint8_t addr)
+{
+    return (map[addr / 32 % STWI_SCAN_WORDS] >> (addr % 32)) & 0x01;
+}
+
+#endif /* SOFTBUS_STWI_SCAN_H */
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2020 Oleg Dolgy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Periodic polling of devices on top of Software Two Wire Interface.
+ *
+ */
+
+#include "stwi_sched.h"
+
+/* Check whether time 'a' is after time 'b' (time wraps around) */
+static bool stwi_sched_after(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) > 0;
+}
+
+/* Get absolute deadline of the task */
+static uint32_t stwi_sched_due(struct stwi_sched_task const *task)
+{
+    return task->release + task->deadline;
+}
+
+/* Collect released tasks with the earliest absolute deadlines in the order of deadlines */
+static size_t stwi_sched_collect(struct stwi_sched const *sched,
+                                 uint32_t now,
+                                 struct stwi_sched_task **batch)
+{
+    size_t count = 0;
+    for (struct stwi_sched_task *task = sched->tasks; task; task = task->next)
+    {
+        if (stwi_sched_after(task->release, now)) { continue; }
+        /* Insert after the tasks with earlier or equal deadlines, the latest one drops out */
+        size_t i = (count < STWI_SCHED_BATCH_MAX) ? count++ : count;
+        for (; i > 0 && stwi_sched_after(stwi_sched_due(batch[i - 1]), stwi_sched_due(task)); i--)
+        {
+            if (i < STWI_SCHED_BATCH_MAX) { batch[i] = batch[i - 1]; }
+        }
+        if (i < STWI_SCHED_BATCH_MAX) { batch[i] = task; }
+    }
+    return count;
+}
+
+void stwi_sched_init(struct stwi_sched *sched,
+                     struct stwi const *bus,
+                     uint32_t (*now)(struct stwi_sched const *sched))
+{
+    *sched = (struct stwi_sched){
+        .bus = bus,
+        .now = now,
+    };
+}
+
+void stwi_sched_add(struct stwi_sched *sched, struct stwi_sched_task *task)
+{
+    task->release = sched->now(sched);
+    task->missed = 0;
+    task->next = sched->tasks;
+    sched->tasks = task;
+}
+
+void stwi_sched_remove(struct stwi_sched *sched, struct stwi_sched_task *task)
+{
+    for (struct stwi_sched_task **link = &sched->tasks; *link; link = &(*link)->next)
+    {
+        if (*link == task)
+        {
+            *link = task->next;
+            return;
+        }
+    }
+}
+
+size_t stwi_sched_run(struct stwi_sched *sched)
+{
+    struct stwi_sched_task *batch[STWI_SCHED_BATCH_MAX];
+    struct stwi_op ops[STWI_SCHED_BATCH_MAX];
+    struct stwi_res res[STWI_SCHED_BATCH_MAX];
+    size_t count = stwi_sched_collect(sched, sched->now(sched), batch);
+    for (size_t i = 0; i < count; i++)
+    {
+        struct stwi_sched_task const *task = batch[i];
+        ops[i] = (struct stwi_op){
+            .dir = STWI_DIR_READ,
+            .addr = task->addr,
+            .reg_size = task->reg_size,
+            .reg = task->reg,
+            .buff = task->buff,
+            .size = task->size,
+        };
+    }
+    /* Tasks after an error stay released for the next run */
+    count = stwi_dev_batch(sched->bus, ops, count, res);
+    uint32_t now = sched->now(sched);
+    for (size_t i = 0; i < count; i++)
+    {
+        struct stwi_sched_task *task = batch[i];
+        bool late = stwi_sched_after(now, stwi_sched_due(task));
+        if (late)
+        {
+            task->missed++;
+            sched->missed++;
+        }
+        /* Next release, periods with deadlines in the past are skipped */
+        task->release += task->period;
+        while (stwi_sched_after(now, stwi_sched_due(task)))
+        {
+            task->release += task->period;
+            task->missed++;
+            sched->missed++;
+        }
+        if (task->done) { task->done(task, &res[i], late); }
+    }
+    return count;
+}
+
+uint32_t stwi_sched_wait(struct stwi_sched const *sched)
+{
+    uint32_t now = sched->now(sched);
+    uint32_t wait = UINT32_MAX;
+    for (struct stwi_sched_task *task = sched->tasks; task; task = task->next)
+    {
+        uint32_t left = stwi_sched_after(task->release, now) ? task->release - now : 0;
+        if (left < wait) { wait = left; }
+    }
+    return wait;
+}
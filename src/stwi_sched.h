@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2020 Oleg Dolgy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Periodic polling of devices on top of Software Two Wire Interface.
+ *
+ * Every task reads a register range of a device into its buffer once per period, the read
+ * must be finished within the deadline after the task is released. Released tasks are
+ * read as one transaction with repeated start conditions (see stwi_dev_batch()) in the order
+ * of their absolute deadlines (earliest deadline first), results are delivered through
+ * the callback of the task when the transaction is finished:
+ *
+ *     stwi_sched_init(&sched, &bus, now);
+ *     stwi_sched_add(&sched, &accel);
+ *     stwi_sched_add(&sched, &temp);
+ *     for (;;)
+ *     {
+ *         stwi_sched_run(&sched);
+ *         sleep for stwi_sched_wait(&sched)
+ *     }
+ *
+ * Time is measured in any units of the 'now' callback and may wrap around.
+ *
+ */
+
+#ifndef SOFTBUS_STWI_SCHED_H
+#define SOFTBUS_STWI_SCHED_H
+
+#include "stwi.h"
+
+/* Maximum number of reads in one transaction */
+#ifndef STWI_SCHED_BATCH_MAX
+#define STWI_SCHED_BATCH_MAX 8
+#endif
+
+struct stwi_sched;
+
+/* Periodic read */
+struct stwi_sched_task
+{
+    /* Register range of the device with 7-bit address */
+    uint8_t addr;
+    stwi_reg_size_t reg_size;
+    uint16_t reg;
+    uint8_t *buff;
+    size_t size;
+    /* Period (non-zero) and relative deadline (not longer than the period) */
+    uint32_t period;
+    uint32_t deadline;
+    /* Optional: the read is done, 'late' if it has missed the deadline */
+    void (*done)(struct stwi_sched_task *task, struct stwi_res const *res, bool late);
+    /* User context */
+    void *ctx;
+    /* Number of missed deadlines, including the skipped periods */
+    uint32_t missed;
+    /* Internal state */
+    uint32_t release;
+    struct stwi_sched_task *next;
+};
+
+/* Scheduler */
+struct stwi_sched
+{
+    struct stwi const *bus;
+    /* Get current time */
+    uint32_t (*now)(struct stwi_sched const *sched);
+    /* Registered tasks */
+    struct stwi_sched_task *tasks;
+    /* Number of missed deadlines of all tasks */
+    uint32_t missed;
+};
+
+/* Initialize scheduler without tasks */
+void stwi_sched_init(struct stwi_sched *sched,
+                     struct stwi const *bus,
+                     uint32_t (*now)(struct stwi_sched const *sched));
+
+/* Register task, it is released immediately */
+void stwi_sched_add(struct stwi_sched *sched, struct stwi_sched_task *task);
+
+/* Unregister task */
+void stwi_sched_remove(struct stwi_sched *sched, struct stwi_sched_task *task);
+
+/* Read released tasks in the order of deadlines as one transaction, up to one read per task
+ * and STWI_SCHED_BATCH_MAX reads. The transaction is aborted at the first error, the failed
+ * read is delivered to its task and the following tasks stay released.
+ * Returns the number of delivered reads. */
+size_t stwi_sched_run(struct stwi_sched *sched);
+
+/* Get time until the next release, zero if a task is released, UINT32_MAX without tasks */
+uint32_t stwi_sched_wait(struct stwi_sched const *sched);
+
+#endif /* SOFTBUS_STWI_SCHED_H */
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2020 Oleg Dolgy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * SMBus protocol on top of Software Two Wire Interface.
+ *
+ */
+
+#include "stwi_smbus.h"
+
+/* CRC-8 with polynomial x^8 + x^2 + x + 1 for every value of 'crc ^ byte' */
+static uint8_t const stwi_smbus_crc[256] = {
+    0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D,
+    0x70, 0x77, 0x7E, 0x79, 0x6C, 0x6B, 0x62, 0x65, 0x48, 0x4F, 0x46, 0x41, 0x54, 0x53, 0x5A, 0x5D,
+    0xE0, 0xE7, 0xEE, 0xE9, 0xFC, 0xFB, 0xF2, 0xF5, 0xD8, 0xDF, 0xD6, 0xD1, 0xC4, 0xC3, 0xCA, 0xCD,
+    0x90, 0x97, 0x9E, 0x99, 0x8C, 0x8B, 0x82, 0x85, 0xA8, 0xAF, 0xA6, 0xA1, 0xB4, 0xB3, 0xBA, 0xBD,
+    0xC7, 0xC0, 0xC9, 0xCE, 0xDB, 0xDC, 0xD5, 0xD2, 0xFF, 0xF8, 0xF1, 0xF6, 0xE3, 0xE4, 0xED, 0xEA,
+    0xB7, 0xB0, 0xB9, 0xBE, 0xAB, 0xAC, 0xA5, 0xA2, 0x8F, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9D, 0x9A,
+    0x27, 0x20, 0x29, 0x2E, 0x3B, 0x3C, 0x35, 0x32, 0x1F, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0D, 0x0A,
+    0x57, 0x50, 0x59, 0x5E, 0x4B, 0x4C, 0x45, 0x42, 0x6F, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7D, 0x7A,
+    0x89, 0x8E, 0x87, 0x80, 0x95, 0x92, 0x9B, 0x9C, 0xB1, 0xB6, 0xBF, 0xB8, 0xAD, 0xAA, 0xA3, 0xA4,
+    0xF9, 0xFE, 0xF7, 0xF0, 0xE5, 0xE2, 0xEB, 0xEC, 0xC1, 0xC6, 0xCF, 0xC8, 0xDD, 0xDA, 0xD3, 0xD4,
+    0x69, 0x6E, 0x67, 0x60, 0x75, 0x72, 0x7B, 0x7C, 0x51, 0x56, 0x5F, 0x58, 0x4D, 0x4A, 0x43, 0x44,
+    0x19, 0x1E, 0x17, 0x10, 0x05, 0x02, 0x0B, 0x0C, 0x21, 0x26, 0x2F, 0x28, 0x3D, 0x3A, 0x33, 0x34,
+    0x4E, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5C, 0x5B, 0x76, 0x71, 0x78, 0x7F, 0x6A, 0x6D, 0x64, 0x63,
+    0x3E, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2C, 0x2B, 0x06, 0x01, 0x08, 0x0F, 0x1A, 0x1D, 0x14, 0x13,
+    0xAE, 0xA9, 0xA0, 0xA7, 0xB2, 0xB5, 0xBC, 0xBB, 0x96, 0x91, 0x98, 0x9F, 0x8A, 0x8D, 0x84, 0x83,
+    0xDE, 0xD9, 0xD0, 0xD7, 0xC2, 0xC5, 0xCC, 0xCB, 0xE6, 0xE1, 0xE8, 0xEF, 0xFA, 0xFD, 0xF4, 0xF3,
+};
+
+/* Transfer state */
+struct stwi_smbus_xfer
+{
+    struct stwi_smbus const *smbus;
+    uint8_t pec;
+    struct stwi_res res;
+};
+
+/* Send byte and update PEC */
+static stwi_err_t stwi_smbus_send(struct stwi_smbus_xfer *xfer, uint8_t byte)
+{
+    xfer->pec = stwi_smbus_crc[xfer->pec ^ byte];
+    return xfer->res.err = stwi_write_byte(xfer->smbus->bus, byte);
+}
+
+/* Receive byte and update PEC */
+static stwi_err_t stwi_smbus_recv(struct stwi_smbus_xfer *xfer, uint8_t *byte, bool ack)
+{
+    STWI_ASSERT(!(xfer->res.err = stwi_read_byte(xfer->smbus->bus, byte, ack)), return xfer->res.err;);
+    xfer->pec = stwi_smbus_crc[xfer->pec ^ *byte];
+    return STWI_ERR_OK;
+}
+
+/* Generate (repeated) start condition and send device address */
+static stwi_err_t stwi_smbus_addr(struct stwi_smbus_xfer *xfer, stwi_dir_t dir)
+{
+    struct stwi_smbus const *smbus = xfer->smbus;
+    xfer->res.stage = STWI_STAGE_START;
+    stwi_dev_select(smbus->bus, smbus->addr);
+    STWI_ASSERT(!(xfer->res.err = stwi_start(smbus->bus)), return xfer->res.err;);
+    xfer->res.stage = STWI_STAGE_ADDR;
+    return stwi_smbus_send(xfer, smbus->addr << 1 | ((dir == STWI_DIR_READ) ? 0x01 : 0x00));
+}
+
+/* Generate start condition, send device address with WRITE bit and command */
+static stwi_err_t stwi_smbus_cmd(struct stwi_smbus_xfer *xfer, uint8_t cmd)
+{
+    STWI_ASSERT(!stwi_smbus_addr(xfer, STWI_DIR_WRITE), return xfer->res.err;);
+    xfer->res.stage = STWI_STAGE_REG;
+    return stwi_smbus_send(xfer, cmd);
+}
+
+/* Send data */
+static stwi_err_t stwi_smbus_send_data(struct stwi_smbus_xfer *xfer, uint8_t const *buff, size_t size)
+{
+    xfer->res.stage = STWI_STAGE_DATA;
+    for (size_t i = 0; i < size; i++)
+    {
+        STWI_ASSERT(!stwi_smbus_send(xfer, buff[i]), return xfer->res.err;);
+        xfer->res.data_size++;
+    }
+    return STWI_ERR_OK;
+}
+
+/* Receive data, the last byte is acknowledged if PEC follows */
+static stwi_err_t stwi_smbus_recv_data(struct stwi_smbus_xfer *xfer, uint8_t *buff, size_t size)
+{
+    xfer->res.stage = STWI_STAGE_DATA;
+    for (size_t i = 0; i < size; i++)
+    {
+        STWI_ASSERT(!stwi_smbus_recv(xfer, &buff[i], i + 1 < size || xfer->smbus->pec), return xfer->res.err;);
+        xfer->res.data_size++;
+    }
+    return STWI_ERR_OK;
+}
+
+/* Send PEC if it is enabled and generate stop condition */
+static stwi_err_t stwi_smbus_end_write(struct stwi_smbus_xfer *xfer)
+{
+    if (xfer->smbus->pec)
+    {
+        STWI_ASSERT(!(xfer->res.err = stwi_write_byte(xfer->smbus->bus, xfer->pec)), return xfer->res.err;);
+    }
+    xfer->res.stage = STWI_STAGE_STOP;
+    return xfer->res.err = stwi_stop(xfer->smbus->bus);
+}
+
+/* Receive PEC if it is enabled, generate stop condition and check PEC */
+static stwi_err_t stwi_smbus_end_read(struct stwi_smbus_xfer *xfer)
+{
+    uint8_t pec = xfer->pec;
+    if (xfer->smbus->pec)
+    {
+        STWI_ASSERT(!(xfer->res.err = stwi_read_byte(xfer->smbus->bus, &pec, false)), return xfer->res.err;);
+    }
+    xfer->res.stage = STWI_STAGE_STOP;
+    STWI_ASSERT(!(xfer->res.err = stwi_stop(xfer->smbus->bus)), return xfer->res.err;);
+    STWI_ASSERT(pec == xfer->pec, return xfer->res.err = STWI_ERR_PEC;);
+    return STWI_ERR_OK;
+}
+
+uint8_t stwi_smbus_pec(uint8_t pec, uint8_t const *buff, size_t size)
+{
+    while (size--)
+    {
+        pec = stwi_smbus_crc[pec ^ *buff++];
+    }
+    return pec;
+}
+
+struct stwi_res stwi_smbus_write_word(struct stwi_smbus const *smbus, uint8_t cmd, uint16_t value)
+{
+    struct stwi_smbus_xfer xfer = {.smbus = smbus};
+    uint8_t data[2] = {value & 0xFF, value >> 8};
+    STWI_ASSERT(!stwi_smbus_cmd(&xfer, cmd), return xfer.res;);
+    STWI_ASSERT(!stwi_smbus_send_data(&xfer, data, sizeof(data)), return xfer.res;);
+    stwi_smbus_end_write(&xfer);
+    return xfer.res;
+}
+
+struct stwi_res stwi_smbus_read_word(struct stwi_smbus const *smbus, uint8_t cmd, uint16_t *value)
+{
+    struct stwi_smbus_xfer xfer = {.smbus = smbus};
+    uint8_t data[2];
+    STWI_ASSERT(!stwi_smbus_cmd(&xfer, cmd), return xfer.res;);
+    STWI_ASSERT(!stwi_smbus_addr(&xfer, STWI_DIR_READ), return xfer.res;);
+    STWI_ASSERT(!stwi_smbus_recv_data(&xfer, data, sizeof(data)), return xfer.res;);
+    *value = data[1] << 8 | data[0];
+    stwi_smbus_end_read(&xfer);
+    return xfer.res;
+}
+
+struct stwi_res stwi_smbus_process_call(struct stwi_smbus const *smbus, uint8_t cmd, uint16_t value, uint16_t *reply)
+{
+    struct stwi_smbus_xfer xfer = {.smbus = smbus};
+    uint8_t data[2] = {value & 0xFF, value >> 8};
+    STWI_ASSERT(!stwi_smbus_cmd(&xfer, cmd), return xfer.res;);
+    STWI_ASSERT(!stwi_smbus_send_data(&xfer, data, sizeof(data)), return xfer.res;);
+    STWI_ASSERT(!stwi_smbus_addr(&xfer, STWI_DIR_READ), return xfer.res;);
+    STWI_ASSERT(!stwi_smbus_recv_data(&xfer, data, sizeof(data)), return xfer.res;);
+    *reply = data[1] << 8 | data[0];
+    stwi_smbus_end_read(&xfer);
+    return xfer.res;
+}
+
+struct stwi_res stwi_smbus_block_write(struct stwi_smbus const *smbus, uint8_t cmd, uint8_t const *buff, uint8_t size)
+{
+    struct stwi_smbus_xfer xfer = {.smbus = smbus};
+    STWI_ASSERT(size <= STWI_SMBUS_BLOCK_MAX, return (struct stwi_res){.err = STWI_ERR_SIZE};);
+    STWI_ASSERT(!stwi_smbus_cmd(&xfer, cmd), return xfer.res;);
+    STWI_ASSERT(!stwi_smbus_send(&xfer, size), return xfer.res;);
+    STWI_ASSERT(!stwi_smbus_send_data(&xfer, buff, size), return xfer.res;);
+    stwi_smbus_end_write(&xfer);
+    return xfer.res;
+}
+
+struct stwi_res stwi_smbus_block_read(struct stwi_smbus const *smbus, uint8_t cmd, uint8_t *buff, uint8_t *size)
+{
+    struct stwi_smbus_xfer xfer = {.smbus = smbus};
+    uint8_t count;
+    *size = 0;
+    STWI_ASSERT(!stwi_smbus_cmd(&xfer, cmd), return xfer.res;);
+    STWI_ASSERT(!stwi_smbus_addr(&xfer, STWI_DIR_READ), return xfer.res;);
+    /* Receive byte count, it is acknowledged if data or PEC follows */
+    xfer.res.stage = STWI_STAGE_DATA;
+    STWI_ASSERT(!(xfer.res.err = stwi_read_data(smbus->bus, &count)), return xfer.res;);
+    xfer.pec = stwi_smbus_crc[xfer.pec ^ count];
+    /* A count that doesn't fit the buffer is not acknowledged and the transfer is ended */
+    bool const fits = count <= STWI_SMBUS_BLOCK_MAX;
+    STWI_ASSERT(!(xfer.res.err = stwi_write_bit(smbus->bus, fits && (count || smbus->pec) ? STWI_PIN_LOW : STWI_PIN_HIGH)),
+                return xfer.res;);
+    if (!fits)
+    {
+        xfer.res.stage = STWI_STAGE_STOP;
+        STWI_ASSERT(!(xfer.res.err = stwi_stop(smbus->bus)), return xfer.res;);
+        xfer.res.err = STWI_ERR_SIZE;
+        return xfer.res;
+    }
+    STWI_ASSERT(!stwi_smbus_recv_data(&xfer, buff, count), return xfer.res;);
+    *size = count;
+    stwi_smbus_end_read(&xfer);
+    return xfer.res;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2020 Oleg Dolgy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * SMBus protocol on top of Software Two Wire Interface.
+ *
+ * Word values are sent low byte first. If Packet Error Checking is enabled, the PEC (CRC-8
+ * of all bytes of the transaction including address bytes) is updated as each byte is sent
+ * or received, sent at the end of writes and checked at the end of reads: a mismatch
+ * is reported as STWI_ERR_PEC after stop condition. Data size of the result counts data
+ * bytes without command, block count and PEC.
+ *
+ */
+
+#ifndef SOFTBUS_STWI_SMBUS_H
+#define SOFTBUS_STWI_SMBUS_H
+
+#include "stwi.h"
+
+/* Maximum data size of block transfers */
+#define STWI_SMBUS_BLOCK_MAX 32
+
+/* SMBus device handle */
+struct stwi_smbus
+{
+    struct stwi const *bus;
+    /* 7-bit device address */
+    uint8_t addr;
+    /* Packet Error Checking is enabled */
+    bool pec;
+};
+
+/* Update PEC with data array */
+uint8_t stwi_smbus_pec(uint8_t pec, uint8_t const *buff, size_t size);
+
+/* Write Word: command and 16-bit value */
+struct stwi_res stwi_smbus_write_word(struct stwi_smbus const *smbus, uint8_t cmd, uint16_t value);
+
+/* Read Word: command, then 16-bit value is received */
+struct stwi_res stwi_smbus_read_word(struct stwi_smbus const *smbus, uint8_t cmd, uint16_t *value);
+
+/* Process Call: command and 16-bit value, then 16-bit reply is received */
+struct stwi_res stwi_smbus_process_call(struct stwi_smbus const *smbus, uint8_t cmd, uint16_t value, uint16_t *reply);
+
+/* Block Write: command, byte count and up to STWI_SMBUS_BLOCK_MAX bytes of data,
+ * a longer block isn't sent and STWI_ERR_SIZE is returned */
+struct stwi_res stwi_smbus_block_write(struct stwi_smbus const *smbus, uint8_t cmd, uint8_t const *buff, uint8_t size);
+
+/* Block Read: command, then byte count and data are received into 'buff' of
+ * STWI_SMBUS_BLOCK_MAX bytes. 'size' is set to the data size. A larger count is not
+ * acknowledged, stop condition is generated and STWI_ERR_SIZE is returned with 'size' 0. */
+struct stwi_res stwi_smbus_block_read(struct stwi_smbus const *smbus, uint8_t cmd, uint8_t *buff, uint8_t *size);
+
+#endif /* SOFTBUS_STWI_SMBUS_H */
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2020 Oleg Dolgy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Per-device clock speed of Software Two Wire Interface.
+ *
+ */
+
+#include "stwi_speed.h"
+
+#include <string.h>
+
+/* Limits of the bit duration in periods of 'delay' */
+#define STWI_SPEED_PERIODS_MIN 4
+#define STWI_SPEED_PERIODS_MAX (4 * 255)
+
+/* Get bit duration in periods of 'delay' for the clock, rounded up to keep the clock */
+static unsigned stwi_speed_periods(uint32_t clock, uint32_t delay_ns)
+{
+    uint64_t bit_ns = (uint64_t)clock * delay_ns;
+    uint64_t periods = bit_ns ? (1000000000 + bit_ns - 1) / bit_ns : STWI_SPEED_PERIODS_MAX;
+    if (periods < STWI_SPEED_PERIODS_MIN) { periods = STWI_SPEED_PERIODS_MIN; }
+    if (periods > STWI_SPEED_PERIODS_MAX) { periods = STWI_SPEED_PERIODS_MAX; }
+    return (unsigned)periods;
+}
+
+/* Get clock for the bit duration, rounded down to keep the bit duration */
+static uint32_t stwi_speed_clock(unsigned periods, uint32_t delay_ns)
+{
+    return (uint32_t)(1000000000 / ((uint64_t)periods * delay_ns));
+}
+
+/* Minimum SCL low and high times of the bus specification modes, ns */
+static struct
+{
+    uint32_t clock;
+    uint32_t low_ns;
+    uint32_t high_ns;
+} const stwi_speed_modes[] = {
+    {STWI_CLOCK_STANDARD, 4700, 4000},
+    {STWI_CLOCK_FAST, 1300, 600},
+    {STWI_CLOCK_FAST_PLUS, 500, 260},
+};
+
+/* Split bit duration between phases: SCL low and high times are proportional to their
+ * minimums in the mode of the clock (faster clocks use fast-mode plus ratio), then each
+ * of them is split in halves, data setup and SCL high time after stretch get the remainder */
+static void stwi_speed_split(struct stwi_timing *timing, unsigned periods, uint32_t delay_ns)
+{
+    uint32_t clock = stwi_speed_clock(periods, delay_ns);
+    size_t mode = 0;
+    size_t const last = sizeof(stwi_speed_modes) / sizeof(stwi_speed_modes[0]) - 1;
+    while (mode < last && clock > stwi_speed_modes[mode].clock) { mode++; }
+    uint32_t low_ns = stwi_speed_modes[mode].low_ns, sum_ns = low_ns + stwi_speed_modes[mode].high_ns;
+    unsigned low = (unsigned)(((uint64_t)periods * low_ns + sum_ns / 2) / sum_ns);
+    /* Every phase takes from one to 255 periods */
+    if (low < 2) { low = 2; }
+    if (low > periods - 2) { low = periods - 2; }
+    if (low > 2 * 255) { low = 2 * 255; }
+    unsigned high = periods - low;
+    *timing = (struct stwi_timing){
+        .su_dat = low - low / 2,
+        .rise = high / 2,
+        .high = high - high / 2,
+        .hd_dat = low / 2,
+    };
+}
+
+/* Get bit duration of the timing */
+static unsigned stwi_speed_sum(struct stwi_timing const *timing)
+{
+    return timing->su_dat + timing->rise + timing->high + timing->hd_dat;
+}
+
+void stwi_speed_timing(struct stwi_timing *timing, uint32_t clock, uint32_t delay_ns)
+{
+    stwi_speed_split(timing, stwi_speed_periods(clock, delay_ns), delay_ns);
+}
+
+void stwi_speed_init(struct stwi_speed *speed)
+{
+    stwi_speed_timing(&speed->other.timing, speed->other.clock, speed->delay_ns);
+    for (size_t i = 0; i < speed->count; i++)
+    {
+        stwi_speed_timing(&speed->devs[i].timing, speed->devs[i].clock, speed->delay_ns);
+    }
+    speed->timing = speed->other.timing;
+}
+
+void stwi_speed_select(struct stwi_speed *speed, uint8_t addr)
+{
+    for (size_t i = 0; i < speed->count; i++)
+    {
+        if (speed->devs[i].addr == addr)
+        {
+            speed->timing = speed->devs[i].timing;
+            return;
+        }
+    }
+    speed->timing = speed->other.timing;
+}
+
+struct stwi_res stwi_speed_tune(struct stwi_speed *speed,
+                                struct stwi const *bus,
+                                struct stwi_speed_dev *dev,
+                                stwi_reg_size_t reg_size,
+                                uint16_t reg,
+                                size_t size,
+                                uint32_t clock_max,
+                                unsigned margin)
+{
+    uint8_t ref[STWI_SPEED_TUNE_MAX], buff[STWI_SPEED_TUNE_MAX];
+    if (size > STWI_SPEED_TUNE_MAX) { size = STWI_SPEED_TUNE_MAX; }
+    /* Reference data with the initial clock */
+    struct stwi_res res = stwi_dev_read(bus, dev->addr, reg_size, reg, ref, size);
+    STWI_ASSERT(!res.err, return res;);
+    /* Shorten the bit by one period of 'delay' while the data is read correctly */
+    struct stwi_timing const timing = dev->timing;
+    unsigned initial = stwi_speed_sum(&timing);
+    unsigned last = stwi_speed_periods(clock_max, speed->delay_ns);
+    unsigned good = initial;
+    while (good > last)
+    {
+        stwi_speed_split(&dev->timing, good - 1, speed->delay_ns);
+        struct stwi_res trial = stwi_dev_read(bus, dev->addr, reg_size, reg, buff, size);
+        if (trial.err || memcmp(ref, buff, size))
+        {
+            /* Release the bus with working timing after the failed transfer */
+            if (trial.err)
+            {
+                stwi_speed_split(&dev->timing, good, speed->delay_ns);
+                stwi_speed_select(speed, dev->addr);
+                stwi_stop(bus);
+            }
+            break;
+        }
+        good--;
+    }
+    /* Back off with the safety margin */
+    unsigned safe = good + (good * margin + 99) / 100;
+    if (safe >= initial)
+    {
+        dev->timing = timing;
+        return res;
+    }
+    dev->clock = stwi_speed_clock(safe, speed->delay_ns);
+    stwi_speed_split(&dev->timing, safe, speed->delay_ns);
+    return res;
+}
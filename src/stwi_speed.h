@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2020 Oleg Dolgy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Per-device clock speed of Software Two Wire Interface.
+ *
+ * One period of 'delay' of the bus is a fixed time unit, the clock of every device is
+ * converted to bit timing in these units and applied before the device is addressed:
+ *
+ *     static struct stwi_speed_dev devs[] = {
+ *         {.addr = 0x50, .clock = STWI_CLOCK_FAST_PLUS},
+ *         {.addr = 0x68, .clock = STWI_CLOCK_STANDARD},
+ *     };
+ *     static struct stwi_speed speed = {
+ *         .delay_ns = 125, .other = {.clock = STWI_CLOCK_FAST}, .devs = devs, .count = 2,
+ *     };
+ *     static void dev_select(struct stwi const *bus, uint8_t addr) { stwi_speed_select(&speed, addr); }
+ *     static struct stwi const bus = {..., .timing = &speed.timing, .dev_select = dev_select};
+ *
+ *     stwi_speed_init(&speed);
+ *
+ */
+
+#ifndef SOFTBUS_STWI_SPEED_H
+#define SOFTBUS_STWI_SPEED_H
+
+#include "stwi.h"
+
+/* Clock frequencies of the bus specification, Hz */
+#define STWI_CLOCK_STANDARD 100000
+#define STWI_CLOCK_FAST 400000
+#define STWI_CLOCK_FAST_PLUS 1000000
+
+/* Maximum data size compared by stwi_speed_tune() */
+#define STWI_SPEED_TUNE_MAX 16
+
+/* Clock speed of the device */
+struct stwi_speed_dev
+{
+    /* 7-bit device address */
+    uint8_t addr;
+    /* Clock frequency, Hz */
+    uint32_t clock;
+    /* Bit timing for the clock, set by stwi_speed_init() */
+    struct stwi_timing timing;
+};
+
+/* Clock speeds of the bus devices */
+struct stwi_speed
+{
+    /* Duration of one 'delay' of the bus, ns */
+    uint32_t delay_ns;
+    /* Clock speed of devices not in the list ('addr' isn't used) */
+    struct stwi_speed_dev other;
+    /* Devices with their own clock speed */
+    struct stwi_speed_dev *devs;
+    size_t count;
+    /* Timing of the addressed device, must be set as 'timing' of the bus */
+    struct stwi_timing timing;
+};
+
+/* Convert clock frequency to bit timing in periods of 'delay' with the specified duration.
+ * SCL low and high times keep the ratio of their minimums in the bus specification
+ * (e.g. 1.3 us and 0.6 us in fast mode), so both meet the minimums at the nominal clock.
+ * A bit takes at least four periods: every phase takes at least one. */
+void stwi_speed_timing(struct stwi_timing *timing, uint32_t clock, uint32_t delay_ns);
+
+/* Compute timings of all devices after their clocks have been changed, select 'other' */
+void stwi_speed_init(struct stwi_speed *speed);
+
+/* Apply timing of the device, should be called by 'dev_select' of the bus */
+void stwi_speed_select(struct stwi_speed *speed, uint8_t addr);
+
+/* Raise the clock of the device until a read of the specified registers fails or returns
+ * different data (the registers must not change), then lower it by 'margin' percent
+ * of the bit period. The clock isn't raised above 'clock_max' and isn't lowered below
+ * the initial one. Returns the result of the reference read with the initial clock. */
+struct stwi_res stwi_speed_tune(struct stwi_speed *speed,
+                                struct stwi const *bus,
+                                struct stwi_speed_dev *dev,
+                                stwi_reg_size_t reg_size,
+                                uint16_t reg,
+                                size_t size,
+                                uint32_t clock_max,
+                                unsigned margin);
+
+#endif /* SOFTBUS_STWI_SPEED_H */
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2020 Oleg Dolgy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Two Wire Interface bus trace.
+ *
+ */
+
+#include "stwi_trace.h"
+
+/* Get trace by bus handle */
+static struct stwi_trace *stwi_trace_get(struct stwi const *bus)
+{
+    return (struct stwi_trace *)bus;
+}
+
+/* Pass the oldest contiguous part of the buffer to the sink */
+static void stwi_trace_drain(struct stwi_trace *trace)
+{
+    size_t tail = (trace->head + trace->size - trace->count) % trace->size;
+    size_t count = (tail + trace->count > trace->size) ? trace->size - tail : trace->count;
+    trace->sink(trace, &trace->events[tail], count);
+    trace->count -= count;
+}
+
+/* Sample lines of the traced bus and store an event if they have changed */
+static void stwi_trace_sample(struct stwi_trace *trace)
+{
+    stwi_pin_state_t scl, sda;
+    stwi_read_lines(trace->target, &scl, &sda);
+    uint8_t lines = (scl ? STWI_TRACE_SCL : 0) | (sda ? STWI_TRACE_SDA : 0);
+    STWI_ASSERT(lines != trace->lines, return;);
+    trace->lines = lines;
+    if (trace->count == trace->size) { stwi_trace_drain(trace); }
+    trace->events[trace->head] = (struct stwi_trace_event){
+        .time = trace->timestamp ? trace->timestamp(trace) : trace->time,
+        .lines = lines,
+    };
+    trace->head = (trace->head + 1) % trace->size;
+    trace->count++;
+}
+
+static void stwi_trace_write_scl(struct stwi const *bus, stwi_pin_state_t state)
+{
+    struct stwi const *target = stwi_trace_get(bus)->target;
+    target->write_scl(target, state);
+}
+
+static void stwi_trace_write_sda(struct stwi const *bus, stwi_pin_state_t state)
+{
+    struct stwi const *target = stwi_trace_get(bus)->target;
+    target->write_sda(target, state);
+}
+
+static stwi_pin_state_t stwi_trace_read_scl(struct stwi const *bus)
+{
+    struct stwi const *target = stwi_trace_get(bus)->target;
+    return target->read_scl(target);
+}
+
+static stwi_pin_state_t stwi_trace_read_sda(struct stwi const *bus)
+{
+    struct stwi const *target = stwi_trace_get(bus)->target;
+    return target->read_sda(target);
+}
+
+static void stwi_trace_delay(struct stwi const *bus)
+{
+    struct stwi_trace *trace = stwi_trace_get(bus);
+    stwi_trace_sample(trace);
+    trace->target->delay(trace->target);
+    trace->time++;
+}
+
+static void stwi_trace_timeout_start(struct stwi const *bus)
+{
+    struct stwi const *target = stwi_trace_get(bus)->target;
+    target->timeout_start(target);
+}
+
+static bool stwi_trace_timeout_check(struct stwi const *bus)
+{
+    struct stwi const *target = stwi_trace_get(bus)->target;
+    return target->timeout_check(target);
+}
+
+static void stwi_trace_write_lines(struct stwi const *bus, stwi_pin_state_t scl, stwi_pin_state_t sda)
+{
+    struct stwi const *target = stwi_trace_get(bus)->target;
+    target->write_lines(target, scl, sda);
+}
+
+static void stwi_trace_read_lines(struct stwi const *bus, stwi_pin_state_t *scl, stwi_pin_state_t *sda)
+{
+    struct stwi const *target = stwi_trace_get(bus)->target;
+    target->read_lines(target, scl, sda);
+}
+
+static void stwi_trace_delay_n(struct stwi const *bus, unsigned n)
+{
+    struct stwi_trace *trace = stwi_trace_get(bus);
+    stwi_trace_sample(trace);
+    trace->target->delay_n(trace->target, n);
+    trace->time += n;
+}
+
+static void stwi_trace_dev_select(struct stwi const *bus, uint8_t addr)
+{
+    struct stwi const *target = stwi_trace_get(bus)->target;
+    target->dev_select(target, addr);
+}
+
+void stwi_trace_init(struct stwi_trace *trace,
+                     struct stwi const *target,
+                     struct stwi_trace_event *events,
+                     size_t size,
+                     stwi_trace_sink_t sink,
+                     void *ctx)
+{
+    *trace = (struct stwi_trace){
+        .bus = {
+            .write_scl = stwi_trace_write_scl,
+            .write_sda = stwi_trace_write_sda,
+            .read_scl = stwi_trace_read_scl,
+            .read_sda = stwi_trace_read_sda,
+            .delay = stwi_trace_delay,
+            .timeout_start = stwi_trace_timeout_start,
+            .timeout_check = stwi_trace_timeout_check,
+            .write_lines = target->write_lines ? stwi_trace_write_lines : NULL,
+            .read_lines = target->read_lines ? stwi_trace_read_lines : NULL,
+            .delay_n = target->delay_n ? stwi_trace_delay_n : NULL,
+            .timing = target->timing,
+            .stretch = target->stretch,
+            .recover = target->recover,
+            .dev_select = target->dev_select ? stwi_trace_dev_select : NULL,
+            .stats = target->stats,
+        },
+        .target = target,
+        .events = events,
+        .size = size,
+        .sink = sink,
+        .ctx = ctx,
+        .lines = 0xFF,
+    };
+}
+
+void stwi_trace_flush(struct stwi_trace *trace)
+{
+    while (trace->count)
+    {
+        stwi_trace_drain(trace);
+    }
+}
+
+void stwi_trace_vcd_write(struct stwi_trace_vcd *vcd, struct stwi_trace_event const *events, size_t count)
+{
+    if (!vcd->header)
+    {
+        fprintf(vcd->file,
+                "$timescale %s $end\n"
+                "$scope module stwi $end\n"
+                "$var wire 1 c scl $end\n"
+                "$var wire 1 d sda $end\n"
+                "$upscope $end\n"
+                "$enddefinitions $end\n",
+                vcd->timescale ? vcd->timescale : "1 us");
+        vcd->header = true;
+        /* Initial values of both lines */
+        vcd->lines = count ? ~events[0].lines : 0;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        uint8_t lines = events[i].lines, changed = lines ^ vcd->lines;
+        vcd->lines = lines;
+        fprintf(vcd->file, "#%lu\n", (unsigned long)events[i].time);
+        if (changed & STWI_TRACE_SCL) { fprintf(vcd->file, "%dc\n", (lines & STWI_TRACE_SCL) ? 1 : 0); }
+        if (changed & STWI_TRACE_SDA) { fprintf(vcd->file, "%dd\n", (lines & STWI_TRACE_SDA) ? 1 : 0); }
+    }
+}
+
+void stwi_trace_log_write(struct stwi_trace_log *log, struct stwi_trace_event const *events, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        uint8_t prev = log->lines, lines = events[i].lines;
+        unsigned long time = events[i].time;
+        log->lines = lines;
+        if ((prev & lines & STWI_TRACE_SCL) && ((prev ^ lines) & STWI_TRACE_SDA))
+        {
+            /* SDA change while SCL is high: start or stop condition */
+            bool start = !(lines & STWI_TRACE_SDA);
+            fprintf(log->file, "%lu %s\n", time, start ? "START" : "STOP");
+            log->active = start;
+            log->addr = true;
+            log->bits = 0;
+            log->shift = 0;
+        }
+        else if (log->active && (lines & ~prev & STWI_TRACE_SCL))
+        {
+            /* SCL rising edge: 8 bits of byte and ACK bit */
+            if (!log->bits) { log->time = events[i].time; }
+            log->shift = log->shift << 1 | ((lines & STWI_TRACE_SDA) ? 0x01 : 0x00);
+            if (++log->bits < 9) { continue; }
+            uint8_t byte = log->shift >> 1 & 0xFF;
+            char const *ack = (log->shift & 0x01) ? "NACK" : "ACK";
+            if (log->addr)
+            {
+                fprintf(log->file, "%lu ADDR 0x%02X %c %s\n", (unsigned long)log->time, byte >> 1,
+                        (byte & 0x01) ? 'R' : 'W', ack);
+            }
+            else
+            {
+                fprintf(log->file, "%lu DATA 0x%02X %s\n", (unsigned long)log->time, byte, ack);
+            }
+            log->addr = false;
+            log->bits = 0;
+            log->shift = 0;
+        }
+    }
+}
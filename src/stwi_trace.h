@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2020 Oleg Dolgy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Two Wire Interface bus trace.
+ *
+ * The trace is a bus handle that forwards all callbacks to the traced bus and samples
+ * both lines at every 'delay' call. Line changes are stored as timestamped events into
+ * a ring buffer of fixed size, which is drained into a sink when it's full, so transfers
+ * of any length are recorded in bounded memory. Stock sinks write VCD files (e.g. for
+ * GTKWave) and a decoded protocol log. The traced bus itself isn't changed, so tracing
+ * costs nothing when the trace handle isn't used:
+ *
+ *     stwi_trace_init(&trace, &bus, events, 256, sink, &ctx);
+ *     stwi_dev_read(&trace.bus, addr, STWI_REG_8, reg, buff, size);
+ *     stwi_trace_flush(&trace);
+ *
+ */
+
+#ifndef SOFTBUS_STWI_TRACE_H
+#define SOFTBUS_STWI_TRACE_H
+
+#include "stwi.h"
+
+#include <stdio.h>
+
+/* SCL line state bit of events */
+#define STWI_TRACE_SCL 0x01
+/* SDA line state bit of events */
+#define STWI_TRACE_SDA 0x02
+
+/* Line states change */
+struct stwi_trace_event
+{
+    uint32_t time;
+    uint8_t lines;
+};
+
+struct stwi_trace;
+
+/* Consumer of events */
+typedef void (*stwi_trace_sink_t)(struct stwi_trace *trace, struct stwi_trace_event const *events, size_t count);
+
+/* Bus trace */
+struct stwi_trace
+{
+    /* Bus handle to be used instead of the traced one, must be the first member */
+    struct stwi bus;
+    /* Traced bus */
+    struct stwi const *target;
+    /* Optional: get current time, number of quarter periods (delays) is used if not set */
+    uint32_t (*timestamp)(struct stwi_trace const *trace);
+    /* Ring buffer of events */
+    struct stwi_trace_event *events;
+    size_t size;
+    size_t head;
+    size_t count;
+    /* Sink is called when the buffer is full and by stwi_trace_flush() */
+    stwi_trace_sink_t sink;
+    /* Sink context */
+    void *ctx;
+    /* Number of delays */
+    uint32_t time;
+    /* Line states of the last event, 0xFF before the first one */
+    uint8_t lines;
+};
+
+/* VCD file writer */
+struct stwi_trace_vcd
+{
+    FILE *file;
+    /* Time unit, e.g. "1 us" (with the default timestamps it's a quarter period) */
+    char const *timescale;
+    /* Header has been written */
+    bool header;
+    /* Line states of the last event */
+    uint8_t lines;
+};
+
+/* Protocol decoder writing text log with one line per condition or byte:
+ * "<time> START", "<time> ADDR 0x25 W ACK", "<time> DATA 0x12 NACK", "<time> STOP" */
+struct stwi_trace_log
+{
+    FILE *file;
+    /* Decoder state */
+    uint8_t lines;
+    bool active;
+    bool addr;
+    uint8_t bits;
+    uint16_t shift;
+    uint32_t time;
+};
+
+/* Initialize trace of the bus, the trace handle has the same optional callbacks */
+void stwi_trace_init(struct stwi_trace *trace,
+                     struct stwi const *target,
+                     struct stwi_trace_event *events,
+                     size_t size,
+                     stwi_trace_sink_t sink,
+                     void *ctx);
+
+/* Pass all buffered events to the sink */
+void stwi_trace_flush(struct stwi_trace *trace);
+
+/* Write events to VCD file */
+void stwi_trace_vcd_write(struct stwi_trace_vcd *vcd, struct stwi_trace_event const *events, size_t count);
+
+/* Decode events and write them to the log */
+void stwi_trace_log_write(struct stwi_trace_log *log, struct stwi_trace_event const *events, size_t count);
+
+#endif /* SOFTBUS_STWI_TRACE_H */
@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2020 Oleg Dolgy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Two Wire Interface waveform renderer.
+ *
+ */
+
+#include "stwi_wave.h"
+
+#include <string.h>
+
+#define SCL STWI_WAVE_SCL
+#define SDA STWI_WAVE_SDA
+
+/* Quarter periods in a bit, a byte with ACK bit and conditions */
+#define STWI_WAVE_BIT 4
+#define STWI_WAVE_BYTE (9 * STWI_WAVE_BIT)
+#define STWI_WAVE_START 4
+#define STWI_WAVE_STOP 3
+
+/* Quarter period where SDA is sampled within a bit */
+#define STWI_WAVE_SAMPLE 2
+
+/* Pin states of a bit with SDA low and high */
+static uint8_t const stwi_wave_bits[2][STWI_WAVE_BIT] = {
+    {0, SCL, SCL, 0},
+    {SDA, SCL | SDA, SCL | SDA, SDA},
+};
+/* Pin states of start condition from idle bus */
+static uint8_t const stwi_wave_start[STWI_WAVE_START] = {SCL | SDA, SCL | SDA, SCL, 0};
+/* Pin states of repeated start condition */
+static uint8_t const stwi_wave_restart[STWI_WAVE_START] = {SDA, SCL | SDA, SCL, 0};
+/* Pin states of stop condition */
+static uint8_t const stwi_wave_stop[STWI_WAVE_STOP] = {0, SCL, SCL | SDA};
+
+/* Number of register address bytes */
+static size_t stwi_wave_reg_bytes(stwi_reg_size_t reg_size)
+{
+    return (reg_size == STWI_REG_16) ? 2 : (reg_size == STWI_REG_8) ? 1 : 0;
+}
+
+/* Render a byte followed by the specified ACK bit (released SDA when sending) */
+static uint8_t *stwi_wave_byte(uint8_t *wave, uint8_t byte, bool ack)
+{
+    for (int i = 0; i < 8; i++, byte <<= 1)
+    {
+        memcpy(wave, stwi_wave_bits[byte >> 7], STWI_WAVE_BIT);
+        wave += STWI_WAVE_BIT;
+    }
+    memcpy(wave, stwi_wave_bits[!ack], STWI_WAVE_BIT);
+    return wave + STWI_WAVE_BIT;
+}
+
+/* Render start condition, device address with WRITE bit and register address */
+static uint8_t *stwi_wave_addr(uint8_t *wave, uint8_t addr, stwi_reg_size_t reg_size, uint16_t reg)
+{
+    memcpy(wave, stwi_wave_start, STWI_WAVE_START);
+    wave += STWI_WAVE_START;
+    wave = stwi_wave_byte(wave, addr << 1 | 0x00, false);
+    if (reg_size == STWI_REG_16) { wave = stwi_wave_byte(wave, reg >> 8 & 0xFF, false); }
+    if (reg_size != STWI_REG_0) { wave = stwi_wave_byte(wave, reg & 0xFF, false); }
+    return wave;
+}
+
+/* Check ACK bit of the byte starting at the specified pin state */
+static bool stwi_wave_ack(uint8_t const *samples, size_t pos)
+{
+    return !(samples[pos + 8 * STWI_WAVE_BIT + STWI_WAVE_SAMPLE] & SDA);
+}
+
+/* Check ACK bits of device address with WRITE bit and register address */
+static size_t stwi_wave_addr_decode(uint8_t const *samples, stwi_reg_size_t reg_size, struct stwi_res *res)
+{
+    size_t pos = STWI_WAVE_START;
+    res->stage = STWI_STAGE_ADDR;
+    STWI_ASSERT(stwi_wave_ack(samples, pos), res->err = STWI_ERR_NACK; return 0;);
+    pos += STWI_WAVE_BYTE;
+    res->stage = STWI_STAGE_REG;
+    for (size_t i = 0; i < stwi_wave_reg_bytes(reg_size); i++)
+    {
+        STWI_ASSERT(stwi_wave_ack(samples, pos), res->err = STWI_ERR_NACK; return 0;);
+        pos += STWI_WAVE_BYTE;
+    }
+    return pos;
+}
+
+size_t stwi_wave_write_size(stwi_reg_size_t reg_size, size_t size)
+{
+    return STWI_WAVE_START + (1 + stwi_wave_reg_bytes(reg_size) + size) * STWI_WAVE_BYTE + STWI_WAVE_STOP;
+}
+
+size_t stwi_wave_read_size(stwi_reg_size_t reg_size, size_t size)
+{
+    return STWI_WAVE_START + (1 + stwi_wave_reg_bytes(reg_size)) * STWI_WAVE_BYTE +
+           STWI_WAVE_START + (1 + size) * STWI_WAVE_BYTE + STWI_WAVE_STOP;
+}
+
+size_t stwi_wave_write(uint8_t *wave,
+                       uint8_t addr,
+                       stwi_reg_size_t reg_size,
+                       uint16_t reg,
+                       uint8_t const *buff,
+                       size_t size)
+{
+    uint8_t *end = stwi_wave_addr(wave, addr, reg_size, reg);
+    while (size--)
+    {
+        end = stwi_wave_byte(end, *buff++, false);
+    }
+    memcpy(end, stwi_wave_stop, STWI_WAVE_STOP);
+    end += STWI_WAVE_STOP;
+    return end - wave;
+}
+
+size_t stwi_wave_read(uint8_t *wave,
+                      uint8_t addr,
+                      stwi_reg_size_t reg_size,
+                      uint16_t reg,
+                      size_t size)
+{
+    uint8_t *end = stwi_wave_addr(wave, addr, reg_size, reg);
+    memcpy(end, stwi_wave_restart, STWI_WAVE_START);
+    end += STWI_WAVE_START;
+    end = stwi_wave_byte(end, addr << 1 | 0x01, false);
+    /* Released SDA while receiving data, ACK for every byte except the last one */
+    while (size--)
+    {
+        end = stwi_wave_byte(end, 0xFF, size > 0);
+    }
+    memcpy(end, stwi_wave_stop, STWI_WAVE_STOP);
+    end += STWI_WAVE_STOP;
+    return end - wave;
+}
+
+struct stwi_res stwi_wave_write_decode(uint8_t const *samples,
+                                       stwi_reg_size_t reg_size,
+                                       size_t size)
+{
+    struct stwi_res res = {};
+    size_t pos = stwi_wave_addr_decode(samples, reg_size, &res);
+    STWI_ASSERT(!res.err, return res;);
+    /* Check ACK bits of data */
+    res.stage = STWI_STAGE_DATA;
+    for (; res.data_size < size; res.data_size++)
+    {
+        STWI_ASSERT(stwi_wave_ack(samples, pos), res.err = STWI_ERR_NACK; return res;);
+        pos += STWI_WAVE_BYTE;
+    }
+    res.stage = STWI_STAGE_STOP;
+    return res;
+}
+
+struct stwi_res stwi_wave_read_decode(uint8_t const *samples,
+                                      stwi_reg_size_t reg_size,
+                                      uint8_t *buff,
+                                      size_t size)
+{
+    struct stwi_res res = {};
+    size_t pos = stwi_wave_addr_decode(samples, reg_size, &res);
+    STWI_ASSERT(!res.err, return res;);
+    /* Check ACK bit of device address with READ bit */
+    pos += STWI_WAVE_START;
+    res.stage = STWI_STAGE_ADDR;
+    STWI_ASSERT(stwi_wave_ack(samples, pos), res.err = STWI_ERR_NACK; return res;);
+    pos += STWI_WAVE_BYTE;
+    /* Decode data */
+    res.stage = STWI_STAGE_DATA;
+    for (; res.data_size < size; res.data_size++)
+    {
+        uint8_t byte = 0;
+        for (int i = 0; i < 8; i++)
+        {
+            byte = byte << 1 | ((samples[pos + STWI_WAVE_SAMPLE] & SDA) ? 0x01 : 0x00);
+            pos += STWI_WAVE_BIT;
+        }
+        pos += STWI_WAVE_BIT;
+        *buff++ = byte;
+    }
+    res.stage = STWI_STAGE_STOP;
+    return res;
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2020 Oleg Dolgy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Two Wire Interface waveform renderer.
+ *
+ * A transaction is rendered into a buffer of pin states, one byte per quarter period
+ * of the clock, that can be played out by DMA or a timer. The waveform is the same as
+ * the one generated by stwi_dev_write() or stwi_dev_read() with default bit timing when
+ * the slave acknowledges every byte and doesn't stretch the clock.
+ *
+ * The playback can't react to the slave, so ACK bits and received data are decoded
+ * afterwards from SDA samples captured at every quarter period (the sample N is the
+ * state of SDA line while the pin state N is being output).
+ *
+ */
+
+#ifndef SOFTBUS_STWI_WAVE_H
+#define SOFTBUS_STWI_WAVE_H
+
+#include "stwi.h"
+
+/* SCL pin state bit */
+#define STWI_WAVE_SCL 0x01
+/* SDA pin state bit */
+#define STWI_WAVE_SDA 0x02
+
+/* Get number of pin states in the waveform of stwi_dev_write() */
+size_t stwi_wave_write_size(stwi_reg_size_t reg_size, size_t size);
+
+/* Get number of pin states in the waveform of stwi_dev_read() */
+size_t stwi_wave_read_size(stwi_reg_size_t reg_size, size_t size);
+
+/* Render waveform of stwi_dev_write().
+ * Returns number of pin states written to 'wave'. */
+size_t stwi_wave_write(uint8_t *wave,
+                       uint8_t addr,
+                       stwi_reg_size_t reg_size,
+                       uint16_t reg,
+                       uint8_t const *buff,
+                       size_t size);
+
+/* Render waveform of stwi_dev_read().
+ * Returns number of pin states written to 'wave'. */
+size_t stwi_wave_read(uint8_t *wave,
+                      uint8_t addr,
+                      stwi_reg_size_t reg_size,
+                      uint16_t reg,
+                      size_t size);
+
+/* Decode ACK bits of the played waveform of stwi_wave_write() */
+struct stwi_res stwi_wave_write_decode(uint8_t const *samples,
+                                       stwi_reg_size_t reg_size,
+                                       size_t size);
+
+/* Decode ACK bits and received data of the played waveform of stwi_wave_read() */
+struct stwi_res stwi_wave_read_decode(uint8_t const *samples,
+                                      stwi_reg_size_t reg_size,
+                                      uint8_t *buff,
+                                      size_t size);
+
+#endif /* SOFTBUS_STWI_WAVE_H */
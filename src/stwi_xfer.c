@@ -0,0 +1,266 @@
+/*
+ * Copyright (c) 2020 Oleg Dolgy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Non-blocking Two Wire Interface transfers.
+ *
+ * Every operation mirrors the corresponding blocking function of "stwi.h": a 'delay'
+ * call there is the end of a tick here.
+ *
+ */
+
+#include "stwi_xfer.h"
+
+/* Operation progress */
+typedef enum
+{
+    /* Wait for the next tick */
+    STWI_XFER_WAIT,
+    /* Operation is complete, continue with the next one in the same tick */
+    STWI_XFER_NEXT,
+    /* Operation failed */
+    STWI_XFER_FAIL,
+} stwi_xfer_step_t;
+
+/* Wait until slave device releases SCL line (clock stretch) */
+static stwi_xfer_step_t stwi_xfer_stretch(struct stwi_xfer *xfer)
+{
+    struct stwi const *bus = xfer->bus;
+    if (bus->read_scl(bus) == STWI_PIN_HIGH)
+    {
+        xfer->stretch = false;
+        return STWI_XFER_NEXT;
+    }
+    if (!xfer->stretch)
+    {
+        bus->timeout_start(bus);
+        xfer->stretch = true;
+    }
+    STWI_ASSERT(bus->timeout_check(bus), xfer->res.err = STWI_ERR_STRETCH; return STWI_XFER_FAIL;);
+    return STWI_XFER_WAIT;
+}
+
+/* Generate clock pulse and send one bit, receive one bit if 'in' is specified */
+static stwi_xfer_step_t stwi_xfer_bit(struct stwi_xfer *xfer, stwi_pin_state_t out, stwi_pin_state_t *in)
+{
+    struct stwi const *bus = xfer->bus;
+    stwi_xfer_step_t step;
+    switch (xfer->phase)
+    {
+    case 0: stwi_write_sda(bus, STWI_PIN_LOW, out); break;
+    case 1: stwi_write_scl(bus, STWI_PIN_HIGH, out); break;
+    case 2:
+        STWI_ASSERT((step = stwi_xfer_stretch(xfer)) == STWI_XFER_NEXT, return step;);
+        break;
+    case 3:
+        if (in) { *in = bus->read_sda(bus); }
+        stwi_write_scl(bus, STWI_PIN_LOW, out);
+        break;
+    default: xfer->phase = 0; return STWI_XFER_NEXT;
+    }
+    xfer->phase++;
+    return STWI_XFER_WAIT;
+}
+
+/* Generate start or repeated start condition */
+static stwi_xfer_step_t stwi_xfer_start(struct stwi_xfer *xfer)
+{
+    struct stwi const *bus = xfer->bus;
+    stwi_xfer_step_t step;
+    switch (xfer->phase)
+    {
+    case 0: bus->write_sda(bus, STWI_PIN_HIGH); break;
+    case 1: stwi_write_scl(bus, STWI_PIN_HIGH, STWI_PIN_HIGH); break;
+    case 2:
+        STWI_ASSERT((step = stwi_xfer_stretch(xfer)) == STWI_XFER_NEXT, return step;);
+        stwi_write_sda(bus, STWI_PIN_HIGH, STWI_PIN_LOW);
+        break;
+    case 3: stwi_write_scl(bus, STWI_PIN_LOW, STWI_PIN_LOW); break;
+    default: xfer->phase = 0; return STWI_XFER_NEXT;
+    }
+    xfer->phase++;
+    return STWI_XFER_WAIT;
+}
+
+/* Generate stop condition */
+static stwi_xfer_step_t stwi_xfer_stop(struct stwi_xfer *xfer)
+{
+    struct stwi const *bus = xfer->bus;
+    stwi_xfer_step_t step;
+    switch (xfer->phase)
+    {
+    case 0: stwi_write_sda(bus, STWI_PIN_LOW, STWI_PIN_LOW); break;
+    case 1: stwi_write_scl(bus, STWI_PIN_HIGH, STWI_PIN_LOW); break;
+    case 2:
+        STWI_ASSERT((step = stwi_xfer_stretch(xfer)) == STWI_XFER_NEXT, return step;);
+        stwi_write_sda(bus, STWI_PIN_HIGH, STWI_PIN_HIGH);
+        break;
+    default: xfer->phase = 0; return STWI_XFER_NEXT;
+    }
+    xfer->phase++;
+    return STWI_XFER_WAIT;
+}
+
+/* Send one byte and receive ACK or NACK bit */
+static stwi_xfer_step_t stwi_xfer_write_byte(struct stwi_xfer *xfer)
+{
+    stwi_xfer_step_t step;
+    /* Send byte */
+    for (; xfer->bit < 8; xfer->bit++)
+    {
+        stwi_pin_state_t bit = (xfer->byte & (0x80 >> xfer->bit)) ? STWI_PIN_HIGH : STWI_PIN_LOW;
+        STWI_ASSERT((step = stwi_xfer_bit(xfer, bit, NULL)) == STWI_XFER_NEXT, return step;);
+    }
+    /* Receive ACK or NACK bit */
+    STWI_ASSERT((step = stwi_xfer_bit(xfer, STWI_PIN_HIGH, &xfer->in)) == STWI_XFER_NEXT, return step;);
+    xfer->bit = 0;
+    STWI_ASSERT(xfer->in == STWI_PIN_LOW, xfer->res.err = STWI_ERR_NACK; return STWI_XFER_FAIL;);
+    return STWI_XFER_NEXT;
+}
+
+/* Receive one byte and send ACK or NACK bit */
+static stwi_xfer_step_t stwi_xfer_read_byte(struct stwi_xfer *xfer)
+{
+    stwi_xfer_step_t step;
+    /* Receive byte */
+    for (; xfer->bit < 8; xfer->bit++)
+    {
+        STWI_ASSERT((step = stwi_xfer_bit(xfer, STWI_PIN_HIGH, &xfer->in)) == STWI_XFER_NEXT, return step;);
+        xfer->byte = xfer->byte << 1 | ((xfer->in == STWI_PIN_HIGH) ? 0x01 : 0x00);
+    }
+    /* Send ACK or NACK bit */
+    bool ack = xfer->res.data_size + 1 < xfer->size;
+    STWI_ASSERT((step = stwi_xfer_bit(xfer, ack ? STWI_PIN_LOW : STWI_PIN_HIGH, NULL)) == STWI_XFER_NEXT, return step;);
+    xfer->bit = 0;
+    return STWI_XFER_NEXT;
+}
+
+/* Go to data stage or stop condition */
+static void stwi_xfer_data(struct stwi_xfer *xfer)
+{
+    if (xfer->res.data_size < xfer->size)
+    {
+        xfer->res.stage = STWI_STAGE_DATA;
+        if (xfer->dir == STWI_DIR_WRITE) { xfer->byte = xfer->buff[xfer->res.data_size]; }
+    }
+    else
+    {
+        xfer->res.stage = STWI_STAGE_STOP;
+    }
+}
+
+/* Go to the stage after register address */
+static void stwi_xfer_reg_done(struct stwi_xfer *xfer)
+{
+    if (xfer->dir == STWI_DIR_READ)
+    {
+        /* Generate repeated start */
+        xfer->restart = true;
+        xfer->res.stage = STWI_STAGE_START;
+    }
+    else
+    {
+        stwi_xfer_data(xfer);
+    }
+}
+
+/* Go to the next stage of the transfer after the current one is complete.
+ * Returns 'false' if the transfer is complete. */
+static bool stwi_xfer_next(struct stwi_xfer *xfer)
+{
+    switch (xfer->res.stage)
+    {
+    case STWI_STAGE_START:
+        /* Send device address with WRITE or READ bit */
+        xfer->res.stage = STWI_STAGE_ADDR;
+        xfer->byte = xfer->addr << 1 | (xfer->restart ? 0x01 : 0x00);
+        return true;
+    case STWI_STAGE_ADDR:
+        if (xfer->restart) { stwi_xfer_data(xfer); }
+        else if (xfer->reg_size == STWI_REG_0) { stwi_xfer_reg_done(xfer); }
+        else
+        {
+            /* Send register high or low byte */
+            xfer->res.stage = STWI_STAGE_REG;
+            xfer->reg_byte = (xfer->reg_size == STWI_REG_16) ? 1 : 0;
+            xfer->byte = xfer->reg >> (8 * xfer->reg_byte) & 0xFF;
+        }
+        return true;
+    case STWI_STAGE_REG:
+        if (xfer->reg_byte)
+        {
+            /* Send register low byte */
+            xfer->reg_byte = 0;
+            xfer->byte = xfer->reg & 0xFF;
+        }
+        else { stwi_xfer_reg_done(xfer); }
+        return true;
+    case STWI_STAGE_DATA:
+        if (xfer->dir == STWI_DIR_READ) { xfer->buff[xfer->res.data_size] = xfer->byte; }
+        xfer->res.data_size++;
+        stwi_xfer_data(xfer);
+        return true;
+    default:
+        return false;
+    }
+}
+
+void stwi_xfer_begin(struct stwi_xfer *xfer,
+                     struct stwi const *bus,
+                     stwi_dir_t dir,
+                     uint8_t addr,
+                     stwi_reg_size_t reg_size,
+                     uint16_t reg,
+                     uint8_t *buff,
+                     size_t size)
+{
+    *xfer = (struct stwi_xfer){
+        .bus = bus,
+        .dir = dir,
+        .addr = addr,
+        .reg_size = reg_size,
+        .reg = reg,
+        .buff = buff,
+        .size = size,
+        .busy = true,
+        .res = {.stage = STWI_STAGE_START},
+    };
+}
+
+bool stwi_tick(struct stwi_xfer *xfer)
+{
+    STWI_ASSERT(xfer->busy, return false;);
+    for (;;)
+    {
+        stwi_xfer_step_t step;
+        switch (xfer->res.stage)
+        {
+        case STWI_STAGE_START: step = stwi_xfer_start(xfer); break;
+        case STWI_STAGE_ADDR:
+        case STWI_STAGE_REG: step = stwi_xfer_write_byte(xfer); break;
+        case STWI_STAGE_DATA:
+            step = (xfer->dir == STWI_DIR_READ) ? stwi_xfer_read_byte(xfer) : stwi_xfer_write_byte(xfer);
+            break;
+        default: step = stwi_xfer_stop(xfer); break;
+        }
+        STWI_ASSERT(step != STWI_XFER_WAIT, return true;);
+        STWI_ASSERT(step == STWI_XFER_NEXT && stwi_xfer_next(xfer), xfer->busy = false; return false;);
+    }
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2020 Oleg Dolgy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Non-blocking Two Wire Interface transfers.
+ *
+ * stwi_tick() performs the pin operations of one quarter period and returns instead of
+ * calling 'delay' of the bus, so it can be called from a timer interrupt or an event loop:
+ *
+ *     stwi_xfer_begin(&xfer, &bus, STWI_DIR_READ, addr, STWI_REG_8, reg, buff, size);
+ *     while (stwi_tick(&xfer)) { wait for a quarter period }
+ *
+ * The waveform and the result are the same as those of stwi_dev_write() or stwi_dev_read()
+ * with default bit timing: every phase takes one tick ('timing' of the bus isn't used).
+ *
+ */
+
+#ifndef SOFTBUS_STWI_XFER_H
+#define SOFTBUS_STWI_XFER_H
+
+#include "stwi.h"
+
+/* Non-blocking transfer context */
+struct stwi_xfer
+{
+    struct stwi const *bus;
+    stwi_dir_t dir;
+    uint8_t addr;
+    stwi_reg_size_t reg_size;
+    uint16_t reg;
+    uint8_t *buff;
+    size_t size;
+    /* Quarter period phase of the current bit or condition */
+    uint8_t phase;
+    /* Bit of the current byte */
+    uint8_t bit;
+    /* Byte being sent or received */
+    uint8_t byte;
+    /* Received bit */
+    stwi_pin_state_t in;
+    /* Register byte being sent */
+    uint8_t reg_byte;
+    /* Repeated start has been generated */
+    bool restart;
+    /* Clock stretch wait is in progress */
+    bool stretch;
+    /* Transfer is in progress */
+    bool busy;
+    /* Current (or final) result */
+    struct stwi_res res;
+};
+
+/* Prepare a transfer of data array to or from the specified register of the device
+ * with 7-bit address. For writes, 'buff' is only read. */
+void stwi_xfer_begin(struct stwi_xfer *xfer,
+                     struct stwi const *bus,
+                     stwi_dir_t dir,
+                     uint8_t addr,
+                     stwi_reg_size_t reg_size,
+                     uint16_t reg,
+                     uint8_t *buff,
+                     size_t size);
+
+/* Advance the transfer by one quarter period.
+ * Returns 'true' if the transfer is in progress and the function should be called again
+ * after a quarter period, 'false' if the transfer is finished and 'res' holds its result. */
+bool stwi_tick(struct stwi_xfer *xfer);
+
+#endif /* SOFTBUS_STWI_XFER_H */
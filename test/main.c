@@ -24,8 +24,24 @@
  */
 
 #include "stwi.h"
+#include "stwi_delay_cal.h"
+#include "stwi_eeprom.h"
+#include "stwi_multi.h"
+#include "stwi_regmap.h"
+#include "stwi_scan.h"
+#include "stwi_sched.h"
+#include "stwi_sim.h"
+#include "stwi_smbus.h"
+#include "stwi_speed.h"
+#include "stwi_trace.h"
+#include "stwi_wave.h"
+#include "stwi_xfer.h"
 #include "unity.h"
 
+#if STWI_MGR
+#include "stwi_mgr.h"
+#include <sched.h>
+#endif
 #include <stdio.h>
 #include <string.h>
 
@@ -165,6 +181,135 @@ static struct stwi const stwi = {
     .timeout_start = timeout_start,
     .timeout_check = timeout_check,
 };
+
+/* Callbacks counters */
+static int pin_calls, lines_calls, delay_n_calls, scl_reads, yield_calls;
+
+static void count_write_scl(struct stwi const *bus, stwi_pin_state_t state)
+{
+    pin_calls++;
+    write_scl(bus, state);
+}
+
+static void count_write_sda(struct stwi const *bus, stwi_pin_state_t state)
+{
+    pin_calls++;
+    write_sda(bus, state);
+}
+
+static stwi_pin_state_t count_read_sda(struct stwi const *bus)
+{
+    pin_calls++;
+    return read_sda(bus);
+}
+
+static void write_lines(struct stwi const *bus, stwi_pin_state_t scl, stwi_pin_state_t sda)
+{
+    lines_calls++;
+    gpio_pin_write(&pin_scl, scl);
+    gpio_pin_write(&pin_sda, sda);
+}
+
+static void read_lines(struct stwi const *bus, stwi_pin_state_t *scl, stwi_pin_state_t *sda)
+{
+    lines_calls++;
+    *scl = gpio_pin_read(&pin_scl);
+    *sda = gpio_pin_read(&pin_sda);
+}
+
+/* The same bus with combined pin callbacks */
+static struct stwi const stwi_lines = {
+    .write_scl = count_write_scl,
+    .write_sda = count_write_sda,
+    .read_scl = read_scl,
+    .read_sda = count_read_sda,
+    .delay = delay,
+    .timeout_start = timeout_start,
+    .timeout_check = timeout_check,
+    .write_lines = write_lines,
+    .read_lines = read_lines,
+};
+
+static void delay_n(struct stwi const *bus, unsigned n)
+{
+    delay_n_calls++;
+    while (n--) { delay(bus); }
+}
+
+/* Asymmetric bit timing without data hold time */
+static struct stwi_timing const timing = {.su_dat = 2, .rise = 1, .high = 1, .hd_dat = 0};
+
+/* The same bus with custom timing */
+static struct stwi const stwi_timed = {
+    .write_scl = write_scl,
+    .write_sda = write_sda,
+    .read_scl = read_scl,
+    .read_sda = read_sda,
+    .delay = delay,
+    .timeout_start = timeout_start,
+    .timeout_check = timeout_check,
+    .delay_n = delay_n,
+    .timing = &timing,
+};
+
+/* The same bus with custom timing and combined line reads */
+static struct stwi const stwi_lines_timed = {
+    .write_scl = write_scl,
+    .write_sda = write_sda,
+    .read_scl = read_scl,
+    .read_sda = read_sda,
+    .delay = delay,
+    .timeout_start = timeout_start,
+    .timeout_check = timeout_check,
+    .read_lines = read_lines,
+    .delay_n = delay_n,
+    .timing = &timing,
+};
+/*------------------------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------------------------*/
+/* Software TWI multi-bus implementation (lane 0 uses the pins above) */
+/*------------------------------------------------------------------------------------------------*/
+static struct gpio_pin pin_scl1, pin_sda1;
+
+static void multi_write_port(struct stwi_multi const *bus, uint32_t scl, uint32_t sda)
+{
+    gpio_pin_write(&pin_scl, scl & 0x01);
+    gpio_pin_write(&pin_sda, sda & 0x01);
+    gpio_pin_write(&pin_scl1, scl >> 1 & 0x01);
+    gpio_pin_write(&pin_sda1, sda >> 1 & 0x01);
+}
+
+static void multi_read_port(struct stwi_multi const *bus, uint32_t *scl, uint32_t *sda)
+{
+    *scl = gpio_pin_read(&pin_scl1) << 1 | gpio_pin_read(&pin_scl);
+    *sda = gpio_pin_read(&pin_sda1) << 1 | gpio_pin_read(&pin_sda);
+}
+
+static void multi_delay(struct stwi_multi const *bus)
+{
+    gpio_pin_sample(&pin_scl1);
+    gpio_pin_sample(&pin_sda1);
+    delay(NULL);
+}
+
+static void multi_timeout_start(struct stwi_multi const *bus)
+{
+    timeout_start(NULL);
+}
+
+static bool multi_timeout_check(struct stwi_multi const *bus)
+{
+    return timeout_check(NULL);
+}
+
+static struct stwi_multi const stwi_multi = {
+    .write_port = multi_write_port,
+    .read_port = multi_read_port,
+    .delay = multi_delay,
+    .timeout_start = multi_timeout_start,
+    .timeout_check = multi_timeout_check,
+};
 /*------------------------------------------------------------------------------------------------*/
 
 /*------------------------------------------------------------------------------------------------*/
@@ -173,8 +318,15 @@ static struct stwi const stwi = {
 void setUp(void)
 {
     stretch_timer = 0;
+    pin_calls = 0;
+    lines_calls = 0;
+    delay_n_calls = 0;
+    scl_reads = 0;
+    yield_calls = 0;
     pin_scl = gpio_pin_new();
     pin_sda = gpio_pin_new();
+    pin_scl1 = gpio_pin_new();
+    pin_sda1 = gpio_pin_new();
 }
 
 void tearDown(void)
@@ -186,6 +338,38 @@ void tearDown(void)
 }
 /*------------------------------------------------------------------------------------------------*/
 
+/*------------------------------------------------------------------------------------------------*/
+/* Helpers */
+/*------------------------------------------------------------------------------------------------*/
+/* Oscillograms of a finished run */
+struct samples
+{
+    char scl[sizeof(pin_scl.samples) + 1];
+    char sda[sizeof(pin_sda.samples) + 1];
+};
+
+/* Save oscillograms of the finished run and reset the pins for the next one */
+static void samples_take(struct samples *samples)
+{
+    strncpy(samples->scl, gpio_pin_get_samples(&pin_scl), sizeof(samples->scl) - 1);
+    strncpy(samples->sda, gpio_pin_get_samples(&pin_sda), sizeof(samples->sda) - 1);
+    setUp();
+}
+
+/* Output waveform as DMA does and capture pin states */
+static void wave_play(uint8_t const *wave, size_t size, uint8_t *capture)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        gpio_pin_write(&pin_scl, (wave[i] & STWI_WAVE_SCL) ? STWI_PIN_HIGH : STWI_PIN_LOW);
+        gpio_pin_write(&pin_sda, (wave[i] & STWI_WAVE_SDA) ? STWI_PIN_HIGH : STWI_PIN_LOW);
+        delay(&stwi);
+        capture[i] = (gpio_pin_read(&pin_scl) ? STWI_WAVE_SCL : 0) |
+                     (gpio_pin_read(&pin_sda) ? STWI_WAVE_SDA : 0);
+    }
+}
+/*------------------------------------------------------------------------------------------------*/
+
 /*------------------------------------------------------------------------------------------------*/
 /* Tests */
 /*------------------------------------------------------------------------------------------------*/
@@ -207,6 +391,44 @@ static void test_start_stretch(void)
     TEST_ASSERT_EQUAL_STRING("^^^^^\\_", gpio_pin_get_samples(&pin_sda));
 }
 
+/* Clock stretch polling with backoff */
+static stwi_pin_state_t count_read_scl(struct stwi const *bus)
+{
+    scl_reads++;
+    return read_scl(bus);
+}
+
+static void yield(struct stwi const *bus, unsigned n)
+{
+    yield_calls++;
+    delay_n(bus, n);
+}
+
+static struct stwi_stretch const stretch = {.spin = 2, .backoff_max = 6, .yield = yield, .yield_after = 2};
+
+static struct stwi const stwi_backoff = {
+    .write_scl = write_scl,
+    .write_sda = write_sda,
+    .read_scl = count_read_scl,
+    .read_sda = read_sda,
+    .delay = delay,
+    .timeout_start = timeout_start,
+    .timeout_check = timeout_check,
+    .delay_n = delay_n,
+    .stretch = &stretch,
+};
+
+static void test_start_stretch_backoff(void)
+{
+    gpio_pin_set_in(&pin_scl, "__________");
+    TEST_ASSERT_EQUAL_INT(stwi_start(&stwi_backoff), STWI_ERR_OK);
+    /* Polls after 0, 0, 1, 2, 4 and 4 periods (the last two waits yield) */
+    TEST_ASSERT_EQUAL_INT(1 + 6, scl_reads);
+    TEST_ASSERT_EQUAL_INT(2, yield_calls);
+    TEST_ASSERT_EQUAL_STRING("\\_________/^^^\\", gpio_pin_get_samples(&pin_scl));
+    TEST_ASSERT_EQUAL_STRING("^^^^^^^^^^^^^\\_", gpio_pin_get_samples(&pin_sda));
+}
+
 static void test_start_stretch_timeout(void)
 {
     gpio_pin_set_in(&pin_scl, "\\_________________");
@@ -232,6 +454,44 @@ static void test_stop(void)
     TEST_ASSERT_EQUAL_STRING("^^\\___/", gpio_pin_get_samples(&pin_sda));
 }
 
+static void test_recover(void)
+{
+    /* A device holds SDA low for the rest of its byte, it releases SDA on the third pulse */
+    gpio_pin_set_in(&pin_sda, "___________");
+    struct stwi_recovery rec = stwi_recover(&stwi);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, rec.err);
+    TEST_ASSERT_FALSE(rec.scl_low);
+    TEST_ASSERT_TRUE(rec.sda_low);
+    TEST_ASSERT_EQUAL_UINT8(3, rec.pulses);
+    TEST_ASSERT_EQUAL_STRING("^^^\\_/^\\_/^\\_/^\\_/^", gpio_pin_get_samples(&pin_scl));
+    TEST_ASSERT_EQUAL_STRING("\\__________/^^^^\\_/", gpio_pin_get_samples(&pin_sda));
+
+    /* A device stretches the clock shorter than the timeout */
+    setUp();
+    gpio_pin_set_in(&pin_scl, "\\___");
+    rec = stwi_recover(&stwi);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, rec.err);
+    TEST_ASSERT_FALSE(rec.scl_low);
+    TEST_ASSERT_FALSE(rec.sda_low);
+    TEST_ASSERT_EQUAL_UINT8(0, rec.pulses);
+}
+
+static void test_recover_err(void)
+{
+    gpio_pin_set_in(&pin_sda, "\\__________________________________________________");
+    struct stwi_recovery rec = stwi_recover(&stwi);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_BUS, rec.err);
+    TEST_ASSERT_TRUE(rec.sda_low);
+    TEST_ASSERT_EQUAL_UINT8(9, rec.pulses);
+
+    setUp();
+    gpio_pin_set_in(&pin_scl, "\\_________________");
+    rec = stwi_recover(&stwi);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_STRETCH, rec.err);
+    TEST_ASSERT_TRUE(rec.scl_low);
+    TEST_ASSERT_EQUAL_UINT8(0, rec.pulses);
+}
+
 static void test_stop_stretch(void)
 {
     TEST_ASSERT_EQUAL_INT(stwi_start(&stwi), STWI_ERR_OK);
@@ -667,44 +927,1861 @@ static void test_dev_read_err_stop(void)
     TEST_ASSERT_EQUAL_size_t(2, res.data_size);
     TEST_ASSERT_EQUAL_UINT8_ARRAY("\xBF\xFE", buff, 2);
 }
-/*------------------------------------------------------------------------------------------------*/
 
-/*------------------------------------------------------------------------------------------------*/
-int main(void)
+static void test_multi_dev_write(void)
 {
-    UNITY_BEGIN();
-    RUN_TEST(test_start);
-    RUN_TEST(test_start_stretch);
-    RUN_TEST(test_start_stretch_timeout);
-    RUN_TEST(test_repeated_start);
-    RUN_TEST(test_stop);
-    RUN_TEST(test_stop_stretch);
-    RUN_TEST(test_read_byte_ack);
-    RUN_TEST(test_read_byte_nack);
-    RUN_TEST(test_read_byte_stretch);
-    RUN_TEST(test_write_byte_ack);
-    RUN_TEST(test_write_byte_nack);
-    RUN_TEST(test_write_byte_stretch);
-    RUN_TEST(test_write_2bytes);
-    RUN_TEST(test_read_2bytes);
-    RUN_TEST(test_dev_write_reg16);
-    RUN_TEST(test_dev_write_reg8);
-    RUN_TEST(test_dev_write_reg0);
-    RUN_TEST(test_dev_write_err_start);
-    RUN_TEST(test_dev_write_err_addr);
-    RUN_TEST(test_dev_write_err_reg);
-    RUN_TEST(test_dev_write_err_data);
-    RUN_TEST(test_dev_write_err_stop);
-    RUN_TEST(test_dev_read_reg16);
-    RUN_TEST(test_dev_read_reg8);
-    RUN_TEST(test_dev_read_reg0);
-    RUN_TEST(test_dev_read_err_start);
-    RUN_TEST(test_dev_read_err_addr);
-    RUN_TEST(test_dev_read_err_reg);
-    RUN_TEST(test_dev_read_err_rep_start);
-    RUN_TEST(test_dev_read_err_rep_addr);
-    RUN_TEST(test_dev_read_err_data);
-    RUN_TEST(test_dev_read_err_stop);
+    char const *sda = "^^^^"                                    /* Start */
+                      "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                      "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 1 + ACK */
+                      "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Data 1 + ACK */
+                      "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___";  /* Data 2 + ACK */
+    /* Lane 0 behaves as a single bus */
+    gpio_pin_set_in(&pin_sda, sda);
+    struct stwi_res res[2] = {};
+    uint8_t const *buffs[2] = {(uint8_t *)"\x12\x34", (uint8_t *)"\x56\x78"};
+    stwi_multi_dev_write(&stwi_multi, 0x03, 0x25, STWI_REG_8, 0xF2, buffs, 2, res);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res[0].err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_STOP, res[0].stage);
+    TEST_ASSERT_EQUAL_size_t(2, res[0].data_size);
+    TEST_ASSERT_EQUAL_STRING("^^^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\"
+                             "_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\"
+                             "_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^",
+                             gpio_pin_get_samples(&pin_scl));
+    TEST_ASSERT_EQUAL_STRING("^^\\_____/^^^\\_______/^^^\\___/^^^\\_______/^^^^^^^^^^^^^^^\\___"
+                             "____/^^^\\___________________/^^^\\_______/^^^\\_______________/^"
+                             "^^^^^^\\___/^^^\\_____________/",
+                             gpio_pin_get_samples(&pin_sda));
+    /* Lane 1 has no device and keeps its lines after NACK */
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_NACK, res[1].err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_ADDR, res[1].stage);
+    TEST_ASSERT_EQUAL_size_t(0, res[1].data_size);
+    TEST_ASSERT_EQUAL_STRING("^^^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\"
+                             "____________________________________________________________________"
+                             "___________________________________________",
+                             gpio_pin_get_samples(&pin_scl1));
+    TEST_ASSERT_EQUAL_STRING("^^\\_____/^^^\\_______/^^^\\___/^^^\\___/^^^"
+                             "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^"
+                             "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^",
+                             gpio_pin_get_samples(&pin_sda1));
+}
+
+static void test_multi_dev_read(void)
+{
+    char const *sda0 = "^^^^"                                    /* Start */
+                       "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                       "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 1 + ACK */
+                       "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 2 + ACK */
+                       "^^^^"                                    /* Repeated start */
+                       "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                       "/^^^\\___/^^^^^^^^^^^^^^^^^^^^^^^^^^^"   /* Data 1 + ACK */
+                       "^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___/^^^";  /* Data 2 + ACK */
+    char const *sda1 = "^^^^"                                    /* Start */
+                       "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                       "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 1 + ACK */
+                       "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 2 + ACK */
+                       "^^^^"                                    /* Repeated start */
+                       "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                       "________________/^^^^^^^\\_______/^^^"   /* Data 1 + ACK */
+                       "\\_______________________/^^^^^^^^^^^";  /* Data 2 + ACK */
+    /* Get reference oscillograms of the single bus */
+    gpio_pin_set_in(&pin_sda, sda0);
+    uint8_t buff[2] = {};
+    struct stwi_res ref = stwi_dev_read(&stwi, 0x25, STWI_REG_16, 0xF1F2, buff, 2);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, ref.err);
+    struct samples samples = {};
+    samples_take(&samples);
+
+    gpio_pin_set_in(&pin_sda, sda0);
+    gpio_pin_set_in(&pin_sda1, sda1);
+    uint8_t buff0[2] = {}, buff1[2] = {};
+    uint8_t *buffs[2] = {buff0, buff1};
+    struct stwi_res res[2] = {};
+    stwi_multi_dev_read(&stwi_multi, 0x03, 0x25, STWI_REG_16, 0xF1F2, buffs, 2, res);
+    for (int lane = 0; lane < 2; lane++)
+    {
+        TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res[lane].err);
+        TEST_ASSERT_EQUAL_INT(STWI_STAGE_STOP, res[lane].stage);
+        TEST_ASSERT_EQUAL_size_t(2, res[lane].data_size);
+    }
+    TEST_ASSERT_EQUAL_UINT8_ARRAY("\xBF\xFE", buff0, 2);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY("\x0C\x03", buff1, 2);
+    TEST_ASSERT_EQUAL_STRING(samples.scl, gpio_pin_get_samples(&pin_scl));
+    TEST_ASSERT_EQUAL_STRING(samples.sda, gpio_pin_get_samples(&pin_sda));
+    TEST_ASSERT_EQUAL_STRING(samples.scl, gpio_pin_get_samples(&pin_scl1));
+}
+
+static void test_multi_dev_read_stretch(void)
+{
+    gpio_pin_set_in(&pin_scl1, "\\_________________"); /* Clock stretch */
+    uint8_t buff0[2] = {}, buff1[2] = {};
+    uint8_t *buffs[2] = {buff0, buff1};
+    struct stwi_res res[2] = {};
+    stwi_multi_dev_read(&stwi_multi, 0x03, 0x25, STWI_REG_8, 0xF2, buffs, 2, res);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_NACK, res[0].err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_ADDR, res[0].stage);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_STRETCH, res[1].err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_START, res[1].stage);
+    TEST_ASSERT_EQUAL_size_t(0, res[1].data_size);
+}
+
+static void test_lines_dev_write(void)
+{
+    char const *sda = "^^^^"                                    /* Start */
+                      "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                      "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 1 + ACK */
+                      "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 2 + ACK */
+                      "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Data 1 + ACK */
+                      "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___";  /* Data 2 + ACK */
+    gpio_pin_set_in(&pin_sda, sda);
+    struct stwi_res ref = stwi_dev_write(&stwi, 0x25, STWI_REG_16, 0xF1F2, (uint8_t *)"\x12\x34", 2);
+    struct samples samples = {};
+    samples_take(&samples);
+
+    gpio_pin_set_in(&pin_sda, sda);
+    struct stwi_res res = stwi_dev_write(&stwi_lines, 0x25, STWI_REG_16, 0xF1F2, (uint8_t *)"\x12\x34", 2);
+    TEST_ASSERT_EQUAL_MEMORY(&ref, &res, sizeof(res));
+    TEST_ASSERT_EQUAL_STRING(samples.scl, gpio_pin_get_samples(&pin_scl));
+    TEST_ASSERT_EQUAL_STRING(samples.sda, gpio_pin_get_samples(&pin_sda));
+    /* Only the release of SDA at start uses a single pin callback,
+     * ACK bits are sampled together with the clock stretch check.
+     * SCL is written twice per bit, SDA only where its level changes (7, 3, 4, 5 and 5 times
+     * in the bytes) and to release it before ACK bit after a low bit (4 times). */
+    TEST_ASSERT_EQUAL_INT(1, pin_calls);
+    TEST_ASSERT_EQUAL_INT(3 + 5 * (9 * 2 + 1) + (7 + 3 + 4 + 5 + 5) + 4 + 3, lines_calls);
+}
+
+/* C++ front end instantiated with policies forwarding to the bus callbacks (see "stwi_hpp.cpp") */
+struct stwi_res hpp_dev_write(struct stwi const *bus,
+                              uint8_t addr,
+                              stwi_reg_size_t reg_size,
+                              uint16_t reg,
+                              uint8_t const *buff,
+                              size_t size);
+struct stwi_res hpp_dev_read(struct stwi const *bus,
+                             uint8_t addr,
+                             stwi_reg_size_t reg_size,
+                             uint16_t reg,
+                             uint8_t *buff,
+                             size_t size);
+/* The same with 'stretch = false' pins policy */
+struct stwi_res hpp_nostretch_dev_write(struct stwi const *bus,
+                                        uint8_t addr,
+                                        stwi_reg_size_t reg_size,
+                                        uint16_t reg,
+                                        uint8_t const *buff,
+                                        size_t size);
+struct stwi_res hpp_nostretch_dev_read(struct stwi const *bus,
+                                       uint8_t addr,
+                                       stwi_reg_size_t reg_size,
+                                       uint16_t reg,
+                                       uint8_t *buff,
+                                       size_t size);
+
+static void test_hpp_dev_write(void)
+{
+    char const *sda = "^^^^"                                    /* Start */
+                      "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                      "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 1 + ACK */
+                      "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 2 + ACK */
+                      "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Data 1 + ACK */
+                      "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^";   /* Data 2 + NACK */
+    gpio_pin_set_in(&pin_sda, sda);
+    struct stwi_res ref = stwi_dev_write(&stwi, 0x25, STWI_REG_16, 0xF1F2, (uint8_t *)"\x12\x34", 2);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_NACK, ref.err);
+    struct samples samples = {};
+    samples_take(&samples);
+
+    gpio_pin_set_in(&pin_sda, sda);
+    struct stwi_res res = hpp_dev_write(&stwi, 0x25, STWI_REG_16, 0xF1F2, (uint8_t *)"\x12\x34", 2);
+    TEST_ASSERT_EQUAL_MEMORY(&ref, &res, sizeof(res));
+    TEST_ASSERT_EQUAL_STRING(samples.scl, gpio_pin_get_samples(&pin_scl));
+    TEST_ASSERT_EQUAL_STRING(samples.sda, gpio_pin_get_samples(&pin_sda));
+}
+
+static void test_hpp_dev_read(void)
+{
+    char const *sda = "^^^^"                                    /* Start */
+                      "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                      "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 1 + ACK */
+                      "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 2 + ACK */
+                      "^^^^"                                    /* Repeated start */
+                      "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                      "/^^^\\___/^^^^^^^^^^^^^^^^^^^^^^^^^^^"   /* Data 1 + ACK */
+                      "^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___/^^^";  /* Data 2 + ACK */
+    gpio_pin_set_in(&pin_sda, sda);
+    uint8_t ref_buff[2] = {};
+    struct stwi_res ref = stwi_dev_read(&stwi, 0x25, STWI_REG_16, 0xF1F2, ref_buff, 2);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, ref.err);
+    struct samples samples = {};
+    samples_take(&samples);
+
+    gpio_pin_set_in(&pin_sda, sda);
+    uint8_t buff[2] = {};
+    struct stwi_res res = hpp_dev_read(&stwi, 0x25, STWI_REG_16, 0xF1F2, buff, 2);
+    TEST_ASSERT_EQUAL_MEMORY(&ref, &res, sizeof(res));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(ref_buff, buff, 2);
+    TEST_ASSERT_EQUAL_STRING(samples.scl, gpio_pin_get_samples(&pin_scl));
+    TEST_ASSERT_EQUAL_STRING(samples.sda, gpio_pin_get_samples(&pin_sda));
+}
+
+static void test_hpp_dev_read_stretch(void)
+{
+    char const *scl = "^^\\______/"; /* Clock stretch at start */
+    gpio_pin_set_in(&pin_scl, scl);
+    uint8_t buff[2] = {};
+    struct stwi_res ref = stwi_dev_read(&stwi, 0x25, STWI_REG_8, 0xF2, buff, 2);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_NACK, ref.err);
+    struct samples samples = {};
+    samples_take(&samples);
+
+    gpio_pin_set_in(&pin_scl, scl);
+    struct stwi_res res = hpp_dev_read(&stwi, 0x25, STWI_REG_8, 0xF2, buff, 2);
+    TEST_ASSERT_EQUAL_MEMORY(&ref, &res, sizeof(res));
+    TEST_ASSERT_EQUAL_STRING(samples.scl, gpio_pin_get_samples(&pin_scl));
+    TEST_ASSERT_EQUAL_STRING(samples.sda, gpio_pin_get_samples(&pin_sda));
+}
+
+static void test_hpp_nostretch(void)
+{
+    char const *sda = "^^^^"                                    /* Start */
+                      "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                      "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register + ACK */
+                      "^^^^"                                    /* Repeated start */
+                      "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                      "/^^^\\___/^^^^^^^^^^^^^^^^^^^^^^^^^^^"   /* Data 1 + ACK */
+                      "^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___/^^^";  /* Data 2 + ACK */
+    gpio_pin_set_in(&pin_sda, sda);
+    uint8_t ref_buff[2] = {};
+    struct stwi_res ref = stwi_dev_read(&stwi, 0x25, STWI_REG_8, 0xF2, ref_buff, 2);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, ref.err);
+    struct samples samples = {};
+    samples_take(&samples);
+
+    gpio_pin_set_in(&pin_sda, sda);
+    uint8_t buff[2] = {};
+    struct stwi_res res = hpp_nostretch_dev_read(&stwi, 0x25, STWI_REG_8, 0xF2, buff, 2);
+    TEST_ASSERT_EQUAL_MEMORY(&ref, &res, sizeof(res));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(ref_buff, buff, 2);
+    TEST_ASSERT_EQUAL_STRING(samples.scl, gpio_pin_get_samples(&pin_scl));
+    TEST_ASSERT_EQUAL_STRING(samples.sda, gpio_pin_get_samples(&pin_sda));
+
+    /* SCL held low by a device doesn't delay the bus without clock stretching */
+    setUp();
+    ref = stwi_dev_write(&stwi, 0x25, STWI_REG_8, 0xF2, (uint8_t *)"\x12", 1);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_NACK, ref.err);
+    samples_take(&samples);
+
+    gpio_pin_set_in(&pin_scl, "^^\\______/");
+    res = hpp_nostretch_dev_write(&stwi, 0x25, STWI_REG_8, 0xF2, (uint8_t *)"\x12", 1);
+    TEST_ASSERT_EQUAL_MEMORY(&ref, &res, sizeof(res));
+    TEST_ASSERT_EQUAL_STRING(samples.sda, gpio_pin_get_samples(&pin_sda));
+    TEST_ASSERT_EQUAL_size_t(strlen(samples.scl), strlen(gpio_pin_get_samples(&pin_scl)));
+}
+
+static void test_lines_read_byte_stretch(void)
+{
+    TEST_ASSERT_EQUAL_INT(stwi_start(&stwi_lines), STWI_ERR_OK);
+    gpio_pin_set_in(&pin_scl, "_/^\\___/^\\___/^\\___/^\\_/^\\_/^\\_/^\\_/^\\_/^\\");
+    gpio_pin_set_in(&pin_sda, "/^^^\\_______/^^^\\_________/^^^\\___");
+    uint8_t byte = 0x00;
+    TEST_ASSERT_EQUAL_INT(stwi_read_byte(&stwi_lines, &byte, true), STWI_ERR_OK);
+    TEST_ASSERT_EQUAL_UINT8(0xA5, byte);
+    /* Bits are sampled with one callback, SDA sampled during clock stretch is discarded */
+    /* Only the release of SDA at start uses a single pin callback, SDA is released once for
+     * the byte, every bit is sampled with one callback and sampled again after each of
+     * 3 clock stretches */
+    TEST_ASSERT_EQUAL_INT(1, pin_calls);
+    TEST_ASSERT_EQUAL_INT(3 + 1 + 8 * 3 + 3 + 3, lines_calls);
+    TEST_ASSERT_EQUAL_STRING("^^^\\_/^\\___/^\\___/^\\___/^\\_/^\\_/^\\_/^\\_/^\\_/^\\",
+                             gpio_pin_get_samples(&pin_scl));
+    TEST_ASSERT_EQUAL_STRING("^^\\_/^^^\\_______/^^^\\_________/^^^\\___/^^^\\___",
+                             gpio_pin_get_samples(&pin_sda));
+}
+
+static void test_lines_read(void)
+{
+    stwi_pin_state_t scl, sda;
+    stwi_read_lines(&stwi_lines, &scl, &sda);
+    TEST_ASSERT_EQUAL_INT(1, lines_calls);
+    TEST_ASSERT_EQUAL_INT(STWI_PIN_HIGH, scl);
+    TEST_ASSERT_EQUAL_INT(STWI_PIN_HIGH, sda);
+    /* Fallback to the single pin callbacks */
+    stwi_read_lines(&stwi, &scl, &sda);
+    TEST_ASSERT_EQUAL_INT(STWI_PIN_HIGH, scl);
+    TEST_ASSERT_EQUAL_INT(STWI_PIN_HIGH, sda);
+}
+
+static void test_wave_write(void)
+{
+    char const *sda = "^^^^"                                    /* Start */
+                      "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                      "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 1 + ACK */
+                      "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 2 + ACK */
+                      "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Data 1 + ACK */
+                      "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___";  /* Data 2 + ACK */
+    gpio_pin_set_in(&pin_sda, sda);
+    stwi_dev_write(&stwi, 0x25, STWI_REG_16, 0xF1F2, (uint8_t *)"\x12\x34", 2);
+    struct samples samples = {};
+    samples_take(&samples);
+
+    uint8_t wave[200], capture[200];
+    size_t size = stwi_wave_write(wave, 0x25, STWI_REG_16, 0xF1F2, (uint8_t *)"\x12\x34", 2);
+    TEST_ASSERT_EQUAL_size_t(stwi_wave_write_size(STWI_REG_16, 2), size);
+    gpio_pin_set_in(&pin_sda, sda);
+    wave_play(wave, size, capture);
+    TEST_ASSERT_EQUAL_STRING(samples.scl, gpio_pin_get_samples(&pin_scl));
+    TEST_ASSERT_EQUAL_STRING(samples.sda, gpio_pin_get_samples(&pin_sda));
+    struct stwi_res res = stwi_wave_write_decode(capture, STWI_REG_16, 2);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_STOP, res.stage);
+    TEST_ASSERT_EQUAL_size_t(2, res.data_size);
+}
+
+static void test_wave_write_err_data(void)
+{
+    uint8_t wave[200], capture[200];
+    size_t size = stwi_wave_write(wave, 0x25, STWI_REG_8, 0xF2, (uint8_t *)"\x12\x34", 2);
+    gpio_pin_set_in(&pin_sda, "^^^^"                                    /* Start */
+                              "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                              "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 1 + ACK */
+                              "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"); /* Data 1 + ACK */
+    wave_play(wave, size, capture);
+    struct stwi_res res = stwi_wave_write_decode(capture, STWI_REG_8, 2);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_NACK, res.err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_DATA, res.stage);
+    TEST_ASSERT_EQUAL_size_t(1, res.data_size);
+}
+
+static void test_wave_read(void)
+{
+    char const *sda = "^^^^"                                    /* Start */
+                      "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                      "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 1 + ACK */
+                      "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 2 + ACK */
+                      "^^^^"                                    /* Repeated start */
+                      "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                      "/^^^\\___/^^^^^^^^^^^^^^^^^^^^^^^^^^^"   /* Data 1 + ACK */
+                      "^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___/^^^";  /* Data 2 + ACK */
+    uint8_t buff[2] = {};
+    gpio_pin_set_in(&pin_sda, sda);
+    stwi_dev_read(&stwi, 0x25, STWI_REG_16, 0xF1F2, buff, 2);
+    struct samples samples = {};
+    samples_take(&samples);
+
+    uint8_t wave[300], capture[300];
+    size_t size = stwi_wave_read(wave, 0x25, STWI_REG_16, 0xF1F2, 2);
+    TEST_ASSERT_EQUAL_size_t(stwi_wave_read_size(STWI_REG_16, 2), size);
+    gpio_pin_set_in(&pin_sda, sda);
+    wave_play(wave, size, capture);
+    TEST_ASSERT_EQUAL_STRING(samples.scl, gpio_pin_get_samples(&pin_scl));
+    TEST_ASSERT_EQUAL_STRING(samples.sda, gpio_pin_get_samples(&pin_sda));
+    memset(buff, 0, sizeof(buff));
+    struct stwi_res res = stwi_wave_read_decode(capture, STWI_REG_16, buff, 2);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_STOP, res.stage);
+    TEST_ASSERT_EQUAL_size_t(2, res.data_size);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY("\xBF\xFE", buff, 2);
+}
+
+static void test_wave_read_err_addr(void)
+{
+    uint8_t wave[300], capture[300];
+    uint8_t buff[2] = {};
+    size_t size = stwi_wave_read(wave, 0x25, STWI_REG_8, 0xF2, 2);
+    wave_play(wave, size, capture);
+    struct stwi_res res = stwi_wave_read_decode(capture, STWI_REG_8, buff, 2);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_NACK, res.err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_ADDR, res.stage);
+    TEST_ASSERT_EQUAL_size_t(0, res.data_size);
+}
+
+/* Compare non-blocking transfer with the blocking one */
+static void xfer_compare(stwi_dir_t dir, stwi_reg_size_t reg_size, char const *scl, char const *sda)
+{
+    uint8_t ref_buff[2] = {}, buff[2] = {};
+    gpio_pin_set_in(&pin_scl, scl);
+    gpio_pin_set_in(&pin_sda, sda);
+    struct stwi_res ref = (dir == STWI_DIR_READ) ?
+                              stwi_dev_read(&stwi, 0x25, reg_size, 0xF1F2, ref_buff, 2) :
+                              stwi_dev_write(&stwi, 0x25, reg_size, 0xF1F2, (uint8_t *)"\x12\x34", 2);
+    int ref_timer = stretch_timer;
+    struct samples samples = {};
+    samples_take(&samples);
+
+    struct stwi_xfer xfer;
+    gpio_pin_set_in(&pin_scl, scl);
+    gpio_pin_set_in(&pin_sda, sda);
+    stwi_xfer_begin(&xfer, &stwi, dir, 0x25, reg_size, 0xF1F2,
+                    (dir == STWI_DIR_READ) ? buff : (uint8_t *)"\x12\x34", 2);
+    while (stwi_tick(&xfer))
+    {
+        delay(&stwi);
+    }
+    TEST_ASSERT_FALSE(stwi_tick(&xfer));
+    TEST_ASSERT_EQUAL_INT(ref.err, xfer.res.err);
+    TEST_ASSERT_EQUAL_INT(ref.stage, xfer.res.stage);
+    TEST_ASSERT_EQUAL_size_t(ref.data_size, xfer.res.data_size);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(ref_buff, buff, 2);
+    TEST_ASSERT_EQUAL_INT(ref_timer, stretch_timer);
+    TEST_ASSERT_EQUAL_STRING(samples.scl, gpio_pin_get_samples(&pin_scl));
+    TEST_ASSERT_EQUAL_STRING(samples.sda, gpio_pin_get_samples(&pin_sda));
+}
+
+static void test_xfer_write(void)
+{
+    xfer_compare(STWI_DIR_WRITE, STWI_REG_16, "",
+                 "^^^^"                                    /* Start */
+                 "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                 "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 1 + ACK */
+                 "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 2 + ACK */
+                 "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Data 1 + ACK */
+                 "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"); /* Data 2 + ACK */
+}
+
+static void test_xfer_write_err_addr(void)
+{
+    xfer_compare(STWI_DIR_WRITE, STWI_REG_8, "____", "");
+}
+
+static void test_xfer_write_err_stop(void)
+{
+    xfer_compare(STWI_DIR_WRITE, STWI_REG_0,
+                 "^^^^"                                    /* Start */
+                 "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^"    /* Address + ACK */
+                 "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^"    /* Data 1 + ACK */
+                 "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^"    /* Data 2 + ACK */
+                 "\\_________________",                   /* Clock stretch */
+                 "^^^^"                                    /* Start */
+                 "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                 "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Data 1 + ACK */
+                 "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"); /* Data 2 + ACK */
+}
+
+static void test_xfer_read(void)
+{
+    xfer_compare(STWI_DIR_READ, STWI_REG_16, "",
+                 "^^^^"                                    /* Start */
+                 "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                 "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 1 + ACK */
+                 "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 2 + ACK */
+                 "^^^^"                                    /* Repeated start */
+                 "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                 "/^^^\\___/^^^^^^^^^^^^^^^^^^^^^^^^^^^"   /* Data 1 + ACK */
+                 "^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___/^^^"); /* Data 2 + ACK */
+}
+
+static void test_xfer_read_stretch(void)
+{
+    xfer_compare(STWI_DIR_READ, STWI_REG_8,
+                 "^^^^"                                    /* Start */
+                 "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^"    /* Address + ACK */
+                 "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^"    /* Register 1 + ACK */
+                 "^^^^"                                    /* Repeated start */
+                 "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^"    /* Repeated address + ACK */
+                 "^^\\__/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^", /* Data 1 + ACK, short stretch */
+                 "^^^^"                                    /* Start */
+                 "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                 "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 1 + ACK */
+                 "/^^^"                                    /* Repeated start */
+                 "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Repeated address + ACK */
+                 "/^^^\\___/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^"); /* Data 1 + ACK */
+}
+
+static void test_xfer_read_err_data(void)
+{
+    xfer_compare(STWI_DIR_READ, STWI_REG_8,
+                 "^^^^"                                    /* Start */
+                 "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^"    /* Address + ACK */
+                 "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^"    /* Register 1 + ACK */
+                 "^^^^"                                    /* Repeated start */
+                 "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^"    /* Repeated address + ACK */
+                 "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^"    /* Data 1 + ACK */
+                 "\\_________________",                   /* Clock stretch */
+                 "^^^^"                                    /* Start */
+                 "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                 "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 1 + ACK */
+                 "/^^^"                                    /* Repeated start */
+                 "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Repeated address + ACK */
+                 "/^^^\\___/^^^^^^^^^^^^^^^^^^^^^^^^^^^"); /* Data 1 + ACK */
+}
+
+static void test_batch(void)
+{
+    gpio_pin_set_in(&pin_sda, "^^^^"                                    /* Start */
+                              "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                              "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 1 + ACK */
+                              "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Data 1 + ACK */
+                              "/^^^"                                    /* Repeated start */
+                              "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                              "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 1 + ACK */
+                              "/^^^"                                    /* Repeated start */
+                              "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                              "/^^^\\___/^^^^^^^^^^^^^^^^^^^^^^^^^^^"   /* Data 1 + ACK */
+                              "^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___/^^^"); /* Data 2 + ACK */
+    uint8_t buff[2] = {};
+    struct stwi_op const ops[] = {
+        {STWI_DIR_WRITE, 0x25, STWI_REG_8, 0xF2, (uint8_t *)"\x12", 1},
+        {STWI_DIR_READ, 0x25, STWI_REG_8, 0x10, &buff[0], 1},
+        {STWI_DIR_READ, 0x25, STWI_REG_8, 0x11, &buff[1], 1},
+    };
+    struct stwi_res res[3] = {};
+    TEST_ASSERT_EQUAL_size_t(3, stwi_dev_batch(&stwi, ops, 3, res));
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res[0].err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_DATA, res[0].stage);
+    TEST_ASSERT_EQUAL_size_t(1, res[0].data_size);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res[1].err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_DATA, res[1].stage);
+    TEST_ASSERT_EQUAL_size_t(1, res[1].data_size);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res[2].err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_STOP, res[2].stage);
+    TEST_ASSERT_EQUAL_size_t(1, res[2].data_size);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY("\xBF\xFE", buff, 2);
+    TEST_ASSERT_EQUAL_STRING("^^^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\"
+                             "_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\"
+                             "_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\"
+                             "_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\"
+                             "_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\"
+                             "_/^",
+                             gpio_pin_get_samples(&pin_scl));
+    TEST_ASSERT_EQUAL_STRING("^^\\_____/^^^\\_______/^^^\\___/^^^\\_______/^^^^^^^^^^^^^^^\\___"
+                             "____/^^^\\___________________/^^^\\_______/^^^\\_______/^\\_____"
+                             "/^^^\\_______/^^^\\___/^^^\\___________________/^^^\\___________"
+                             "________/^\\_____/^^^\\_______/^^^\\___/^^^^^^^\\___/^^^\\___/^^^"
+                             "^^^^^^^^^^^^^^^^^^^^\\___/^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___/^^^"
+                             "\\_/",
+                             gpio_pin_get_samples(&pin_sda));
+}
+
+static void test_batch_err(void)
+{
+    gpio_pin_set_in(&pin_sda, "^^^^"                                    /* Start */
+                              "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                              "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"); /* Data 1 + ACK */
+    uint8_t buff[1] = {};
+    struct stwi_op const ops[] = {
+        {STWI_DIR_WRITE, 0x25, STWI_REG_0, 0x00, (uint8_t *)"\x12", 1},
+        {STWI_DIR_READ, 0x26, STWI_REG_0, 0x00, buff, 1},
+        {STWI_DIR_READ, 0x25, STWI_REG_0, 0x00, buff, 1},
+    };
+    struct stwi_res res[3] = {};
+    TEST_ASSERT_EQUAL_size_t(2, stwi_dev_batch(&stwi, ops, 3, res));
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res[0].err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_DATA, res[0].stage);
+    TEST_ASSERT_EQUAL_size_t(1, res[0].data_size);
+    /* Read without register starts with address with READ bit */
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_NACK, res[1].err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_ADDR, res[1].stage);
+    TEST_ASSERT_EQUAL_size_t(0, res[1].data_size);
+}
+
+static void test_dev_writev(void)
+{
+    char const *sda = "^^^^"                                    /* Start */
+                      "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                      "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 1 + ACK */
+                      "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Data 1 + ACK */
+                      "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Data 2 + ACK */
+                      "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^";   /* Data 3 + NACK */
+    gpio_pin_set_in(&pin_sda, sda);
+    stwi_dev_write(&stwi, 0x25, STWI_REG_8, 0xF2, (uint8_t *)"\x12\x34\x56", 3);
+    struct samples samples = {};
+    samples_take(&samples);
+
+    struct stwi_iov_const const iov[] = {
+        {(uint8_t const *)"\x12", 1},
+        {NULL, 0},
+        {(uint8_t const *)"\x34\x56", 2},
+    };
+    gpio_pin_set_in(&pin_sda, sda);
+    struct stwi_res res = stwi_dev_writev(&stwi, 0x25, STWI_REG_8, 0xF2, iov, 3);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_NACK, res.err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_DATA, res.stage);
+    /* Bytes are counted across segments */
+    TEST_ASSERT_EQUAL_size_t(2, res.data_size);
+    TEST_ASSERT_EQUAL_STRING(samples.scl, gpio_pin_get_samples(&pin_scl));
+    TEST_ASSERT_EQUAL_STRING(samples.sda, gpio_pin_get_samples(&pin_sda));
+}
+
+static void test_dev_readv(void)
+{
+    char const *sda = "^^^^"                                    /* Start */
+                      "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                      "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 1 + ACK */
+                      "^^^^"                                    /* Repeated start */
+                      "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                      "/^^^\\___/^^^^^^^^^^^^^^^^^^^^^^^^^^^"   /* Data 1 + ACK */
+                      "^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___/^^^"   /* Data 2 + ACK */
+                      "\\___^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^";   /* Data 3 + NACK */
+    uint8_t ref_buff[3] = {}, buff[3] = {};
+    gpio_pin_set_in(&pin_sda, sda);
+    stwi_dev_read(&stwi, 0x25, STWI_REG_8, 0xF2, ref_buff, 3);
+    struct samples samples = {};
+    samples_take(&samples);
+
+    struct stwi_iov const iov[] = {
+        {&buff[0], 2},
+        {NULL, 0},
+        {&buff[2], 1},
+    };
+    gpio_pin_set_in(&pin_sda, sda);
+    struct stwi_res res = stwi_dev_readv(&stwi, 0x25, STWI_REG_8, 0xF2, iov, 3);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_STOP, res.stage);
+    TEST_ASSERT_EQUAL_size_t(3, res.data_size);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY("\xBF\xFE\x7F", buff, 3);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(ref_buff, buff, 3);
+    TEST_ASSERT_EQUAL_STRING(samples.scl, gpio_pin_get_samples(&pin_scl));
+    TEST_ASSERT_EQUAL_STRING(samples.sda, gpio_pin_get_samples(&pin_sda));
+}
+
+static void test_eeprom_write(void)
+{
+    gpio_pin_set_in(&pin_sda, "^^^^"                                    /* Start */
+                              "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                              "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Memory address + ACK */
+                              "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Data 1 + ACK */
+                              "/^^"                                     /* Stop */
+                              "^^^^"                                    /* Start */
+                              "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^"    /* Address + NACK (busy) */
+                              "^^^^"                                    /* Repeated start */
+                              "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                              "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Memory address + ACK */
+                              "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Data 2 + ACK */
+                              "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"); /* Data 3 + ACK */
+    struct stwi_eeprom const eeprom = {
+        .bus = &stwi,
+        .addr = 0x50,
+        .reg_size = STWI_REG_8,
+        .page_size = 2,
+        .poll_max = 1,
+    };
+    struct stwi_res res = stwi_eeprom_write(&eeprom, 0x101, (uint8_t *)"\x12\x34\x56", 3);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_STOP, res.stage);
+    TEST_ASSERT_EQUAL_size_t(3, res.data_size);
+    TEST_ASSERT_EQUAL_STRING("^^\\_/^^^\\___/^^^\\___________/^^^\\___________________________"
+                             "________/^^^\\_______________/^^^\\_______/^^^\\_________/^^\\_/"
+                             "^^^\\___/^^^\\___________/^^^\\___/^^^^^\\_/^^^\\___/^^^\\________"
+                             "___/^^^\\_______________________________/^^^\\_______________/"
+                             "^^^^^^^\\___/^^^\\_______________/^^^\\___/^^^\\___/^^^^^^^\\____"
+                             "_____/",
+                             gpio_pin_get_samples(&pin_sda));
+}
+
+static void test_eeprom_init(void)
+{
+    struct stwi_eeprom eeprom;
+    TEST_ASSERT_FALSE(stwi_eeprom_init(&eeprom, &stwi, 0x50, STWI_REG_8, 0, 1));
+    TEST_ASSERT_TRUE(stwi_eeprom_init(&eeprom, &stwi, 0x50, STWI_REG_16, 64, 1));
+    TEST_ASSERT_EQUAL_UINT8(0x50, eeprom.addr);
+    TEST_ASSERT_EQUAL_INT(STWI_REG_16, eeprom.reg_size);
+    TEST_ASSERT_EQUAL_UINT16(64, eeprom.page_size);
+}
+
+static void test_eeprom_write_err_poll(void)
+{
+    gpio_pin_set_in(&pin_sda, "^^^^"                                    /* Start */
+                              "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                              "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Memory address 1 + ACK */
+                              "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Memory address 2 + ACK */
+                              "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Data 1 + ACK */
+                              "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"); /* Data 2 + ACK */
+    struct stwi_eeprom const eeprom = {
+        .bus = &stwi,
+        .addr = 0x50,
+        .reg_size = STWI_REG_16,
+        .page_size = 2,
+        .poll_max = 2,
+    };
+    struct stwi_res res = stwi_eeprom_write(&eeprom, 0x0100, (uint8_t *)"\x12\x34\x56", 3);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_NACK, res.err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_ADDR, res.stage);
+    /* The first page was written, the chip hasn't acknowledged 3 probes */
+    TEST_ASSERT_EQUAL_size_t(2, res.data_size);
+}
+
+static void test_regmap_read(void)
+{
+    uint8_t values[3] = {};
+    uint8_t flags[3] = {0, 0, STWI_REGMAP_VOLATILE};
+    struct stwi_regmap const map = {
+        .bus = &stwi,
+        .addr = 0x25,
+        .reg_size = STWI_REG_16,
+        .base = 0x0110,
+        .count = 3,
+        .values = values,
+        .flags = flags,
+    };
+    uint8_t buff[3] = {};
+    gpio_pin_set_in(&pin_sda, "^^^^"                                    /* Start */
+                              "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                              "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 1 + ACK */
+                              "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 2 + ACK */
+                              "^^^^"                                    /* Repeated start */
+                              "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                              "/^^^\\___/^^^^^^^^^^^^^^^^^^^^^^^^^^^"   /* Data 1 + ACK */
+                              "^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___/^^^"   /* Data 2 + ACK */
+                              "\\___^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^"); /* Data 3 + NACK */
+    struct stwi_res res = stwi_regmap_read(&map, 0x0110, buff, 3);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_size_t(3, res.data_size);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY("\xBF\xFE\x7F", buff, 3);
+    setUp();
+
+    /* Cached registers */
+    res = stwi_regmap_read(&map, 0x0110, buff, 2);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_STOP, res.stage);
+    TEST_ASSERT_EQUAL_size_t(2, res.data_size);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY("\xBF\xFE", buff, 2);
+    TEST_ASSERT_EQUAL_STRING("", gpio_pin_get_samples(&pin_scl));
+
+    /* Only the volatile register is read */
+    struct samples samples = {};
+    gpio_pin_set_in(&pin_sda, "^^^^"                                    /* Start */
+                              "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                              "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 1 + ACK */
+                              "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 2 + ACK */
+                              "^^^^"                                    /* Repeated start */
+                              "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                              "/^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___/^^^"); /* Data 1 + NACK */
+    stwi_dev_read(&stwi, 0x25, STWI_REG_16, 0x0112, buff, 1);
+    samples_take(&samples);
+    gpio_pin_set_in(&pin_sda, "^^^^"                                    /* Start */
+                              "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                              "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 1 + ACK */
+                              "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 2 + ACK */
+                              "^^^^"                                    /* Repeated start */
+                              "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                              "/^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___/^^^"); /* Data 1 + NACK */
+    res = stwi_regmap_read(&map, 0x0111, buff, 2);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_size_t(2, res.data_size);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY("\xFE\xFE", buff, 2);
+    TEST_ASSERT_EQUAL_STRING(samples.scl, gpio_pin_get_samples(&pin_scl));
+    TEST_ASSERT_EQUAL_STRING(samples.sda, gpio_pin_get_samples(&pin_sda));
+    setUp();
+
+    /* Failed read of the volatile register still receives the cached ones */
+    memset(buff, 0, sizeof(buff));
+    res = stwi_regmap_read(&map, 0x0110, buff, 3);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_NACK, res.err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_ADDR, res.stage);
+    TEST_ASSERT_EQUAL_size_t(2, res.data_size);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY("\xBF\xFE", buff, 2);
+}
+
+static void test_regmap_write(void)
+{
+    uint8_t values[4] = {0x00, 0x00, 0x00, 0x00};
+    uint8_t flags[4] = {STWI_REGMAP_VALID, STWI_REGMAP_VALID, STWI_REGMAP_VALID, STWI_REGMAP_VALID};
+    struct stwi_regmap const map = {
+        .bus = &stwi,
+        .addr = 0x25,
+        .reg_size = STWI_REG_8,
+        .base = 0x10,
+        .count = 4,
+        .values = values,
+        .flags = flags,
+    };
+    /* Nothing is changed */
+    struct stwi_res res = stwi_regmap_write(&map, 0x10, (uint8_t *)"\x00\x00", 2);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_size_t(0, res.data_size);
+    TEST_ASSERT_EQUAL_STRING("", gpio_pin_get_samples(&pin_scl));
+
+    /* Two bursts of dirty registers */
+    struct samples samples = {};
+    char const *sda = "^^^^"                                    /* Start */
+                      "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                      "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 1 + ACK */
+                      "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Data 1 + ACK */
+                      "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Data 2 + ACK */
+                      "/^^"                                     /* Stop */
+                      "^^^^"                                    /* Start */
+                      "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Address + ACK */
+                      "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___"   /* Register 1 + ACK */
+                      "/^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___";  /* Data 1 + ACK */
+    gpio_pin_set_in(&pin_sda, sda);
+    stwi_dev_write(&stwi, 0x25, STWI_REG_8, 0x10, (uint8_t *)"\x12\x34", 2);
+    stwi_dev_write(&stwi, 0x25, STWI_REG_8, 0x13, (uint8_t *)"\x56", 1);
+    samples_take(&samples);
+    gpio_pin_set_in(&pin_sda, sda);
+    res = stwi_regmap_write(&map, 0x10, (uint8_t *)"\x12\x34\x00\x56", 4);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_size_t(3, res.data_size);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY("\x12\x34\x00\x56", values, 4);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY("\x02\x02\x02\x02", flags, 4);
+    TEST_ASSERT_EQUAL_STRING(samples.scl, gpio_pin_get_samples(&pin_scl));
+    TEST_ASSERT_EQUAL_STRING(samples.sda, gpio_pin_get_samples(&pin_sda));
+    setUp();
+
+    /* Read-modify-write of a cached register without changes */
+    res = stwi_regmap_update_bits(&map, 0x10, 0x0F, 0x02);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_STRING("", gpio_pin_get_samples(&pin_scl));
+}
+
+static void test_timing_write_byte(void)
+{
+    TEST_ASSERT_EQUAL_INT(stwi_start(&stwi_timed), STWI_ERR_OK);
+    gpio_pin_set_in(&pin_sda, "^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^\\___");
+    TEST_ASSERT_EQUAL_INT(stwi_write_byte(&stwi_timed, 0x5A), STWI_ERR_OK);
+    /* Start: 3 calls, bits: 3 calls each */
+    TEST_ASSERT_EQUAL_INT(3 + 9 * 3, delay_n_calls);
+    /* SDA is changed together with SCL falling edge */
+    TEST_ASSERT_EQUAL_STRING("^^^^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^\\_/^",
+                             gpio_pin_get_samples(&pin_scl));
+    TEST_ASSERT_EQUAL_STRING("^^^\\____/^^^\\___/^^^^^^^\\___/^^^\\_______",
+                             gpio_pin_get_samples(&pin_sda));
+}
+
+static void test_timing_lines_read_byte(void)
+{
+    char const *sda = "^^^^/^^^^\\___/^^^^\\___/^^^^^^^^^^^^^^^^^^^^^^^^";
+    TEST_ASSERT_EQUAL_INT(stwi_start(&stwi_timed), STWI_ERR_OK);
+    gpio_pin_set_in(&pin_sda, sda);
+    uint8_t ref = 0x00;
+    TEST_ASSERT_EQUAL_INT(stwi_read_byte(&stwi_timed, &ref, false), STWI_ERR_OK);
+    struct samples samples = {};
+    samples_take(&samples);
+
+    TEST_ASSERT_EQUAL_INT(stwi_start(&stwi_lines_timed), STWI_ERR_OK);
+    gpio_pin_set_in(&pin_sda, sda);
+    uint8_t byte = 0x00;
+    TEST_ASSERT_EQUAL_INT(stwi_read_byte(&stwi_lines_timed, &byte, false), STWI_ERR_OK);
+    TEST_ASSERT_EQUAL_UINT8(ref, byte);
+    /* Start: 3 calls, received bits: 2 calls each (rise and high times at once), NACK: 3 calls */
+    TEST_ASSERT_EQUAL_INT(3 + 8 * 2 + 3, delay_n_calls);
+    TEST_ASSERT_EQUAL_STRING(samples.scl, gpio_pin_get_samples(&pin_scl));
+    TEST_ASSERT_EQUAL_STRING(samples.sda, gpio_pin_get_samples(&pin_sda));
+}
+
+static void test_sim_eeprom(void)
+{
+    static uint8_t mem[2048], data[1000], buff[1000];
+    struct stwi_sim sim;
+    struct stwi_sim_eeprom chip;
+    stwi_sim_init(&sim);
+    stwi_sim_eeprom_init(&chip, 0x50, STWI_REG_8, mem, sizeof(mem), 16, 200);
+    stwi_sim_attach(&sim, &chip.dev);
+    for (size_t i = 0; i < sizeof(data); i++)
+    {
+        data[i] = (uint8_t)(i * 7 + 3);
+    }
+    struct stwi_eeprom const eeprom = {
+        .bus = &sim.bus,
+        .addr = 0x50,
+        .reg_size = STWI_REG_8,
+        .page_size = 16,
+        .poll_max = 10,
+    };
+    /* Unaligned write across several 256-byte blocks */
+    struct stwi_res res = stwi_eeprom_write(&eeprom, 0x0F5, data, sizeof(data));
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_size_t(sizeof(data), res.data_size);
+    TEST_ASSERT_EQUAL_size_t(1 + 61 + 1, chip.pages_written);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(data, &mem[0x0F5], sizeof(data));
+    /* The chip was busy and didn't acknowledge some probes */
+    TEST_ASSERT_GREATER_THAN(0, sim.nacks);
+
+    res = stwi_eeprom_read(&eeprom, 0x0F5, buff, sizeof(buff));
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_size_t(sizeof(buff), res.data_size);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(data, buff, sizeof(buff));
+}
+
+static void test_sim_regs_stretch(void)
+{
+    uint8_t regs[4] = {0x11, 0x22, 0x33, 0x44};
+    struct stwi_sim sim;
+    struct stwi_sim_regs sensor;
+    stwi_sim_init(&sim);
+    stwi_sim_regs_init(&sensor, 0x25, STWI_REG_16, regs, sizeof(regs));
+    sensor.dev.stretch_byte = 10;
+    sensor.dev.stretch_bit = 1;
+    stwi_sim_attach(&sim, &sensor.dev);
+
+    struct stwi_res res = stwi_dev_write(&sim.bus, 0x25, STWI_REG_16, 0x0003, (uint8_t *)"\x55\x66", 2);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY("\x66\x22\x33\x55", regs, 4);
+    uint8_t buff[3] = {};
+    res = stwi_dev_read(&sim.bus, 0x25, STWI_REG_16, 0x0001, buff, 3);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY("\x22\x33\x55", buff, 3);
+    /* Unknown device */
+    res = stwi_dev_read(&sim.bus, 0x26, STWI_REG_16, 0x0001, buff, 3);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_NACK, res.err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_ADDR, res.stage);
+
+    /* Stretch longer than timeout */
+    sim.stretch_timeout = 5;
+    res = stwi_dev_read(&sim.bus, 0x25, STWI_REG_16, 0x0001, buff, 3);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_STRETCH, res.err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_REG, res.stage);
+}
+
+static void test_scan(void)
+{
+    uint8_t regs[2] = {0x12, 0x34};
+    uint8_t mem[256] = {};
+    struct stwi_sim sim;
+    struct stwi_sim_regs sensor;
+    struct stwi_sim_eeprom eeprom;
+    stwi_sim_init(&sim);
+    stwi_sim_regs_init(&sensor, 0x25, STWI_REG_8, regs, sizeof(regs));
+    stwi_sim_eeprom_init(&eeprom, 0x50, STWI_REG_16, mem, sizeof(mem), 16, 100);
+    stwi_sim_attach(&sim, &sensor.dev);
+    stwi_sim_attach(&sim, &eeprom.dev);
+
+    uint32_t map[STWI_SCAN_WORDS] = {};
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, stwi_scan(&sim.bus, STWI_SCAN_FIRST, STWI_SCAN_LAST, STWI_DIR_WRITE, map));
+    TEST_ASSERT_EQUAL_UINT32(1u << (0x25 - 32), map[1]);
+    TEST_ASSERT_EQUAL_UINT32(1u << (0x50 - 64), map[2]);
+    TEST_ASSERT_EQUAL_UINT32(0, map[0] | map[3]);
+    TEST_ASSERT_TRUE(stwi_scan_found(map, 0x25));
+    TEST_ASSERT_FALSE(stwi_scan_found(map, 0x26));
+    /* 112 probes of 10 clock periods (40 quarter periods) and stop condition */
+    TEST_ASSERT_EQUAL_UINT32(112 * 40 + 3, (uint32_t)sim.time);
+    TEST_ASSERT_EQUAL_UINT32(2, (uint32_t)sim.acks);
+
+    /* Read probes receive one byte from every found device */
+    uint32_t map_read[STWI_SCAN_WORDS] = {};
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, stwi_scan(&sim.bus, STWI_SCAN_FIRST, STWI_SCAN_LAST, STWI_DIR_READ, map_read));
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(map, map_read, STWI_SCAN_WORDS);
+    TEST_ASSERT_EQUAL_UINT32(112 * 40 + 2 * 36 + 3, (uint32_t)sim.time - (112 * 40 + 3));
+
+    /* The bus is released */
+    uint8_t buff[2] = {};
+    struct stwi_res res = stwi_dev_read(&sim.bus, 0x25, STWI_REG_8, 0x00, buff, 2);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(regs, buff, 2);
+}
+
+/* Clock speeds of simulated devices */
+static struct stwi_speed_dev speed_devs[] = {
+    {.addr = 0x25, .clock = STWI_CLOCK_FAST},
+    {.addr = 0x26, .clock = STWI_CLOCK_STANDARD},
+};
+static struct stwi_speed speed;
+
+static void speed_select(struct stwi const *bus, uint8_t addr)
+{
+    stwi_speed_select(&speed, addr);
+}
+
+static void test_speed(void)
+{
+    uint8_t regs[4] = {0x55, 0xAA, 0x0F, 0xF0};
+    uint8_t slow_regs[2] = {0x5A, 0xA5};
+    uint8_t buff[4] = {};
+    struct stwi_sim sim;
+    struct stwi_sim_regs sensor, slow, other;
+    stwi_sim_init(&sim);
+    sim.bus.timing = &speed.timing;
+    sim.bus.dev_select = speed_select;
+    stwi_sim_regs_init(&sensor, 0x25, STWI_REG_8, regs, sizeof(regs));
+    sensor.dev.min_high = 4;
+    stwi_sim_regs_init(&slow, 0x26, STWI_REG_8, slow_regs, sizeof(slow_regs));
+    slow.dev.min_high = 20;
+    stwi_sim_regs_init(&other, 0x27, STWI_REG_8, slow_regs, sizeof(slow_regs));
+    other.dev.min_high = 20;
+    stwi_sim_attach(&sim, &sensor.dev);
+    stwi_sim_attach(&sim, &slow.dev);
+    stwi_sim_attach(&sim, &other.dev);
+
+    /* One 'delay' is 125 ns: 20 periods per bit in fast mode, 80 in standard mode */
+    speed = (struct stwi_speed){
+        .delay_ns = 125,
+        .other = {.clock = STWI_CLOCK_FAST},
+        .devs = speed_devs,
+        .count = 2,
+    };
+    stwi_speed_init(&speed);
+    /* SCL low and high times meet the minimums of fast mode (1.3 us and 0.6 us)
+     * and standard mode (4.7 us and 4.0 us) */
+    struct stwi_timing const *fast = &speed_devs[0].timing, *standard = &speed_devs[1].timing;
+    TEST_ASSERT_EQUAL_UINT32(20, fast->su_dat + fast->rise + fast->high + fast->hd_dat);
+    TEST_ASSERT_GREATER_OR_EQUAL(1300, (fast->su_dat + fast->hd_dat) * 125);
+    TEST_ASSERT_GREATER_OR_EQUAL(600, (fast->rise + fast->high) * 125);
+    TEST_ASSERT_EQUAL_UINT8(3, fast->high);
+    TEST_ASSERT_EQUAL_UINT32(80, standard->su_dat + standard->rise + standard->high + standard->hd_dat);
+    TEST_ASSERT_GREATER_OR_EQUAL(4700, (standard->su_dat + standard->hd_dat) * 125);
+    TEST_ASSERT_GREATER_OR_EQUAL(4000, (standard->rise + standard->high) * 125);
+    TEST_ASSERT_EQUAL_UINT8(19, standard->high);
+
+    /* Every device is addressed with its own clock */
+    struct stwi_res res = stwi_dev_read(&sim.bus, 0x26, STWI_REG_8, 0x00, buff, 2);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(slow_regs, buff, 2);
+    res = stwi_dev_read(&sim.bus, 0x25, STWI_REG_8, 0x00, buff, 4);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(regs, buff, 4);
+    /* The slow device without profile misses clock pulses of fast mode */
+    res = stwi_dev_read(&sim.bus, 0x27, STWI_REG_8, 0x00, buff, 2);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_NACK, res.err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_ADDR, res.stage);
+
+    /* SCL high time of 4 periods needs 11 periods per bit with the ratio of fast-mode plus
+     * (7 periods of SCL low time), 14 with the margin */
+    res = stwi_speed_tune(&speed, &sim.bus, &speed_devs[0], STWI_REG_8, 0x00, 4, 2 * STWI_CLOCK_FAST_PLUS, 25);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_UINT32(571428, speed_devs[0].clock);
+    TEST_ASSERT_EQUAL_UINT8(5, speed_devs[0].timing.su_dat);
+    TEST_ASSERT_EQUAL_UINT8(2, speed_devs[0].timing.rise);
+    TEST_ASSERT_EQUAL_UINT8(3, speed_devs[0].timing.high);
+    TEST_ASSERT_EQUAL_UINT8(4, speed_devs[0].timing.hd_dat);
+    memset(buff, 0, sizeof(buff));
+    res = stwi_dev_read(&sim.bus, 0x25, STWI_REG_8, 0x00, buff, 4);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(regs, buff, 4);
+
+    /* The clock isn't raised above the limit */
+    res = stwi_speed_tune(&speed, &sim.bus, &speed_devs[1], STWI_REG_8, 0x00, 2, STWI_CLOCK_STANDARD, 0);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_UINT32(STWI_CLOCK_STANDARD, speed_devs[1].clock);
+    TEST_ASSERT_EQUAL_UINT8(19, speed_devs[1].timing.high);
+}
+
+static uint32_t sim_timestamp(struct stwi const *bus)
+{
+    return (uint32_t)((struct stwi_sim const *)bus)->time;
+}
+
+#if STWI_STATS
+static void test_stats(void)
+{
+    uint8_t regs[4] = {};
+    struct stwi_sim sim;
+    struct stwi_sim_regs sensor;
+    struct stwi_stats stats = {.timestamp = sim_timestamp};
+    stwi_sim_init(&sim);
+    sim.bus.stats = &stats;
+    stwi_sim_regs_init(&sensor, 0x25, STWI_REG_8, regs, sizeof(regs));
+    sensor.dev.stretch_byte = 6;
+    stwi_sim_attach(&sim, &sensor.dev);
+
+    /* Address, register and data bytes are stretched */
+    struct stwi_res res = stwi_dev_write(&sim.bus, 0x25, STWI_REG_8, 0x00, (uint8_t *)"\x12\x34", 2);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_UINT32(4, stats.bytes);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.transactions);
+    TEST_ASSERT_EQUAL_UINT32(4, stats.stretches);
+    /* 3 of 6 quarter periods of stretch pass before SCL is released by the master */
+    TEST_ASSERT_EQUAL_UINT32(4, stats.stretch_hist[2]);
+    /* 151 quarter periods of the transaction and 12 quarter periods of stretch */
+    TEST_ASSERT_EQUAL_UINT32(1, stats.latency_hist[8]);
+
+    res = stwi_dev_read(&sim.bus, 0x26, STWI_REG_8, 0x00, regs, 2);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_NACK, res.err);
+    TEST_ASSERT_EQUAL_UINT32(5, stats.bytes);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.transactions);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.nacks[STWI_STAGE_ADDR]);
+
+    sim.stretch_timeout = 2;
+    res = stwi_dev_read(&sim.bus, 0x25, STWI_REG_8, 0x00, regs, 2);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_STRETCH, res.err);
+    TEST_ASSERT_EQUAL_UINT32(3, stats.transactions);
+    TEST_ASSERT_EQUAL_UINT32(5, stats.stretches);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.timeouts);
+}
+#else
+static void test_stats_disabled(void)
+{
+    uint8_t regs[4] = {};
+    struct stwi_sim sim;
+    struct stwi_sim_regs sensor;
+    struct stwi_stats stats = {.timestamp = sim_timestamp};
+    stwi_sim_init(&sim);
+    sim.bus.stats = &stats;
+    stwi_sim_regs_init(&sensor, 0x25, STWI_REG_8, regs, sizeof(regs));
+    sensor.dev.stretch_byte = 6;
+    stwi_sim_attach(&sim, &sensor.dev);
+
+    /* Statistics are not updated by the driver compiled without them */
+    struct stwi_res res = stwi_dev_write(&sim.bus, 0x25, STWI_REG_8, 0x00, (uint8_t *)"\x12\x34", 2);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    struct stwi_stats const zero = {.timestamp = sim_timestamp};
+    TEST_ASSERT_EQUAL_MEMORY(&zero, &stats, sizeof(stats));
+}
+#endif
+
+static uint32_t sched_now(struct stwi_sched const *sched)
+{
+    return sim_timestamp(sched->bus);
+}
+
+/* Reads done by scheduler */
+struct sched_log
+{
+    char order[16];
+    size_t count;
+    size_t late;
+};
+
+static void sched_done(struct stwi_sched_task *task, struct stwi_res const *res, bool late)
+{
+    struct sched_log *log = task->ctx;
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res->err);
+    if (log->count < sizeof(log->order) - 1) { log->order[log->count] = (task->addr == 0x25) ? 'A' : 'B'; }
+    log->count++;
+    if (late) { log->late++; }
+}
+
+static void test_sched(void)
+{
+    uint8_t regs_a[4] = {0x11, 0x22, 0x33, 0x44};
+    uint8_t regs_b[2] = {0x55, 0x66};
+    uint8_t buff_a[2] = {}, buff_b[2] = {}, buff_c[2] = {};
+    struct stwi_sim sim;
+    struct stwi_sim_regs sensor_a, sensor_b;
+    stwi_sim_init(&sim);
+    stwi_sim_regs_init(&sensor_a, 0x25, STWI_REG_8, regs_a, sizeof(regs_a));
+    stwi_sim_regs_init(&sensor_b, 0x26, STWI_REG_8, regs_b, sizeof(regs_b));
+    stwi_sim_attach(&sim, &sensor_a.dev);
+    stwi_sim_attach(&sim, &sensor_b.dev);
+
+    struct stwi_sched sched;
+    struct sched_log log = {};
+    stwi_sched_init(&sched, &sim.bus, sched_now);
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, stwi_sched_wait(&sched));
+    /* A read takes 191 quarter periods, both reads in one transaction take 379 and the results
+     * are delivered at its end, the bus is busy for 67% of time */
+    struct stwi_sched_task task_a = {
+        .addr = 0x25, .reg_size = STWI_REG_8, .reg = 0x00, .buff = buff_a, .size = 2,
+        .period = 400, .deadline = 400, .done = sched_done, .ctx = &log,
+    };
+    struct stwi_sched_task task_b = {
+        .addr = 0x26, .reg_size = STWI_REG_8, .reg = 0x00, .buff = buff_b, .size = 2,
+        .period = 1000, .deadline = 390, .done = sched_done, .ctx = &log,
+    };
+    stwi_sched_add(&sched, &task_a);
+    stwi_sched_add(&sched, &task_b);
+    while (sim.time < 4000)
+    {
+        if (stwi_sched_run(&sched)) { continue; }
+        stwi_delay(&sim.bus, stwi_sched_wait(&sched));
+    }
+    /* The task with the earliest deadline goes first */
+    TEST_ASSERT_EQUAL_STRING("BAAABAABAAABAA", log.order);
+    TEST_ASSERT_EQUAL_size_t(0, log.late);
+    TEST_ASSERT_EQUAL_UINT32(0, sched.missed);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(regs_a, buff_a, 2);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(regs_b, buff_b, 2);
+
+    /* Overload: the deadline is shorter than the read */
+    struct stwi_sched_task task_c = {
+        .addr = 0x25, .reg_size = STWI_REG_8, .reg = 0x02, .buff = buff_c, .size = 2,
+        .period = 300, .deadline = 100, .done = sched_done, .ctx = &log,
+    };
+    stwi_sched_add(&sched, &task_c);
+    while (sim.time < 8000)
+    {
+        if (stwi_sched_run(&sched)) { continue; }
+        stwi_delay(&sim.bus, stwi_sched_wait(&sched));
+    }
+    TEST_ASSERT_GREATER_THAN(0, task_c.missed);
+    TEST_ASSERT_EQUAL_UINT32(task_a.missed + task_b.missed + task_c.missed, sched.missed);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(&regs_a[2], buff_c, 2);
+
+    stwi_sched_remove(&sched, &task_c);
+    stwi_sched_remove(&sched, &task_a);
+    stwi_sched_remove(&sched, &task_b);
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, stwi_sched_wait(&sched));
+
+    /* A failed read aborts the transaction, the following tasks stay released */
+    struct stwi_sched_task task_d = {
+        .addr = 0x30, .reg_size = STWI_REG_8, .reg = 0x00, .buff = buff_c, .size = 2,
+        .period = 1000, .deadline = 100,
+    };
+    stwi_sched_add(&sched, &task_a);
+    stwi_sched_add(&sched, &task_d);
+    size_t count = log.count;
+    TEST_ASSERT_EQUAL_size_t(1, stwi_sched_run(&sched));
+    TEST_ASSERT_EQUAL_size_t(count, log.count);
+    TEST_ASSERT_EQUAL_UINT32(0, stwi_sched_wait(&sched));
+    TEST_ASSERT_EQUAL_size_t(1, stwi_sched_run(&sched));
+    TEST_ASSERT_EQUAL_size_t(count + 1, log.count);
+    TEST_ASSERT_GREATER_THAN(0, stwi_sched_wait(&sched));
+}
+
+/* Streamed data: byte N of the stream is (N * 7 + 1) & 0xFF */
+struct stream
+{
+    size_t total;
+    size_t pos;
+    size_t errors;
+};
+
+static size_t stream_produce(void *ctx, uint8_t *chunk, size_t size)
+{
+    struct stream *stream = ctx;
+    size_t count = (stream->total - stream->pos < size) ? stream->total - stream->pos : size;
+    for (size_t i = 0; i < count; i++, stream->pos++)
+    {
+        chunk[i] = (uint8_t)(stream->pos * 7 + 1);
+    }
+    return count;
+}
+
+static size_t stream_consume(void *ctx, uint8_t const *chunk, size_t size)
+{
+    struct stream *stream = ctx;
+    for (size_t i = 0; i < size; i++, stream->pos++)
+    {
+        if (chunk[i] != (uint8_t)(stream->pos * 7 + 1)) { stream->errors++; }
+    }
+    /* Chunks of 5 bytes */
+    return (stream->total - stream->pos < 5) ? stream->total - stream->pos : 5;
+}
+
+/* Block with length byte */
+static size_t block_consume(void *ctx, uint8_t const *chunk, size_t size)
+{
+    size_t *left = ctx;
+    if (size == 0) { return 1; }
+    if (*left == SIZE_MAX)
+    {
+        *left = chunk[0];
+        return *left;
+    }
+    *left = 0;
+    return 0;
+}
+
+static void test_stream(void)
+{
+    static uint8_t mem[4096];
+    struct stwi_sim sim;
+    struct stwi_sim_regs ram;
+    stwi_sim_init(&sim);
+    stwi_sim_regs_init(&ram, 0x50, STWI_REG_16, mem, sizeof(mem));
+    stwi_sim_attach(&sim, &ram.dev);
+
+    /* The whole memory is streamed through 5-byte chunks */
+    uint8_t chunk[5];
+    struct stream stream = {.total = sizeof(mem)};
+    struct stwi_res res = stwi_dev_write_stream(&sim.bus, 0x50, STWI_REG_16, 0x0000, chunk, sizeof(chunk), stream_produce, &stream);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_STOP, res.stage);
+    TEST_ASSERT_EQUAL_size_t(sizeof(mem), res.data_size);
+    TEST_ASSERT_EQUAL_UINT8(1, mem[0]);
+    TEST_ASSERT_EQUAL_UINT8((uint8_t)(4095 * 7 + 1), mem[4095]);
+
+    stream = (struct stream){.total = sizeof(mem)};
+    res = stwi_dev_read_stream(&sim.bus, 0x50, STWI_REG_16, 0x0000, chunk, sizeof(chunk), stream_consume, &stream);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_size_t(sizeof(mem), res.data_size);
+    TEST_ASSERT_EQUAL_size_t(sizeof(mem), stream.pos);
+    TEST_ASSERT_EQUAL_size_t(0, stream.errors);
+
+    /* The length of the block is received first, the last byte gets NACK */
+    mem[0x100] = 3;
+    size_t left = SIZE_MAX;
+    res = stwi_dev_read_stream(&sim.bus, 0x50, STWI_REG_16, 0x0100, chunk, sizeof(chunk), block_consume, &left);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_size_t(4, res.data_size);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(&mem[0x101], chunk, 3);
+    TEST_ASSERT_EQUAL_UINT16(0x0104, ram.ptr);
+
+    /* An empty chunk is rejected without transfer */
+    uint64_t time = sim.time;
+    stream = (struct stream){.total = sizeof(mem)};
+    res = stwi_dev_write_stream(&sim.bus, 0x50, STWI_REG_16, 0x0000, chunk, 0, stream_produce, &stream);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_SIZE, res.err);
+    TEST_ASSERT_EQUAL_size_t(0, res.data_size);
+    res = stwi_dev_read_stream(&sim.bus, 0x50, STWI_REG_16, 0x0000, chunk, 0, stream_consume, &stream);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_SIZE, res.err);
+    TEST_ASSERT_EQUAL_size_t(0, res.data_size);
+    TEST_ASSERT_TRUE(time == sim.time);
+    TEST_ASSERT_EQUAL_size_t(0, stream.pos);
+}
+
+/* Bitwise CRC-8 for reference */
+static uint8_t crc8(uint8_t const *buff, size_t size)
+{
+    uint8_t crc = 0;
+    while (size--)
+    {
+        crc ^= *buff++;
+        for (int i = 0; i < 8; i++) { crc = (crc & 0x80) ? (crc << 1 ^ 0x07) : (crc << 1); }
+    }
+    return crc;
+}
+
+static void test_smbus(void)
+{
+    uint8_t regs[16] = {};
+    struct stwi_sim sim;
+    struct stwi_sim_regs dev;
+    stwi_sim_init(&sim);
+    /* Register map device stands for SMBus device: the command is a register address */
+    stwi_sim_regs_init(&dev, 0x0B, STWI_REG_8, regs, sizeof(regs));
+    stwi_sim_attach(&sim, &dev.dev);
+    struct stwi_smbus smbus = {.bus = &sim.bus, .addr = 0x0B, .pec = true};
+
+    TEST_ASSERT_EQUAL_UINT8(0xF4, stwi_smbus_pec(0, (uint8_t const *)"123456789", 9));
+
+    /* PEC is sent after data */
+    struct stwi_res res = stwi_smbus_write_word(&smbus, 0x02, 0x1234);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_size_t(2, res.data_size);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY("\x34\x12", &regs[0x02], 2);
+    TEST_ASSERT_EQUAL_UINT8(crc8((uint8_t const *)"\x16\x02\x34\x12", 4), regs[0x04]);
+
+    /* PEC is checked after data */
+    memcpy(&regs[0x08], "\xCD\xAB", 2);
+    regs[0x0A] = crc8((uint8_t const *)"\x16\x08\x17\xCD\xAB", 5);
+    uint16_t value = 0;
+    res = stwi_smbus_read_word(&smbus, 0x08, &value);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_UINT16(0xABCD, value);
+    regs[0x09] ^= 0x01;
+    res = stwi_smbus_read_word(&smbus, 0x08, &value);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_PEC, res.err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_STOP, res.stage);
+    TEST_ASSERT_EQUAL_size_t(2, res.data_size);
+    /* Without PEC the last data byte gets NACK */
+    smbus.pec = false;
+    res = stwi_smbus_read_word(&smbus, 0x08, &value);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_UINT16(0xAACD, value);
+    TEST_ASSERT_EQUAL_UINT8(0x0A, dev.ptr);
+    smbus.pec = true;
+
+    /* Process call: the reply follows the written value */
+    memcpy(&regs[0x0C], "\x78\x56", 2);
+    regs[0x0E] = crc8((uint8_t const *)"\x16\x0A\x22\x11\x17\x78\x56", 7);
+    res = stwi_smbus_process_call(&smbus, 0x0A, 0x1122, &value);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_UINT16(0x5678, value);
+    TEST_ASSERT_EQUAL_size_t(4, res.data_size);
+
+    /* Block write and read of the same block */
+    memset(regs, 0, sizeof(regs));
+    res = stwi_smbus_block_write(&smbus, 0x01, (uint8_t const *)"\xA1\xA2\xA3", 3);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY("\x03\xA1\xA2\xA3", &regs[0x01], 4);
+    TEST_ASSERT_EQUAL_UINT8(crc8((uint8_t const *)"\x16\x01\x03\xA1\xA2\xA3", 6), regs[0x05]);
+    regs[0x05] = crc8((uint8_t const *)"\x16\x01\x17\x03\xA1\xA2\xA3", 7);
+    uint8_t block[STWI_SMBUS_BLOCK_MAX], size = 0;
+    res = stwi_smbus_block_read(&smbus, 0x01, block, &size);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_UINT8(3, size);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY("\xA1\xA2\xA3", block, 3);
+
+    /* A block longer than the limit is rejected without transfer */
+    uint8_t large[STWI_SMBUS_BLOCK_MAX + 1] = {};
+    uint64_t time = sim.time;
+    res = stwi_smbus_block_write(&smbus, 0x01, large, sizeof(large));
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_SIZE, res.err);
+    TEST_ASSERT_EQUAL_size_t(0, res.data_size);
+    TEST_ASSERT_TRUE(time == sim.time);
+    TEST_ASSERT_EQUAL_UINT8(0x03, regs[0x01]);
+    /* A count larger than the limit is not acknowledged and no data is read */
+    regs[0x01] = STWI_SMBUS_BLOCK_MAX + 1;
+    size = 0xFF;
+    res = stwi_smbus_block_read(&smbus, 0x01, block, &size);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_SIZE, res.err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_STOP, res.stage);
+    TEST_ASSERT_EQUAL_size_t(0, res.data_size);
+    TEST_ASSERT_EQUAL_UINT8(0, size);
+    TEST_ASSERT_EQUAL_UINT8(0x02, dev.ptr);
+    /* The bus is released after the rejected block */
+    regs[0x01] = 0x03;
+    res = stwi_smbus_block_read(&smbus, 0x01, block, &size);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_UINT8(3, size);
+
+    /* Unknown device */
+    smbus.addr = 0x0C;
+    res = stwi_smbus_block_read(&smbus, 0x01, block, &size);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_NACK, res.err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_ADDR, res.stage);
+}
+
+static void test_transfer(void)
+{
+    uint8_t regs[16] = {0x00, 0x11, 0x22, 0x33};
+    struct stwi_sim sim;
+    struct stwi_sim_regs dev;
+    stwi_sim_init(&sim);
+    stwi_sim_regs_init(&dev, 0x25, STWI_REG_8, regs, sizeof(regs));
+    stwi_sim_attach(&sim, &dev.dev);
+
+    /* Register address and data from separate buffers */
+    struct stwi_msg write[] = {
+        {0x25, 0, 1, (uint8_t *)"\x04"},
+        {0x25, STWI_M_NOSTART, 2, (uint8_t *)"\xAA\xBB"},
+    };
+    struct stwi_res res = stwi_transfer(&sim.bus, write, 2);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_STOP, res.stage);
+    TEST_ASSERT_EQUAL_size_t(2, res.data_size);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY("\xAA\xBB", &regs[0x04], 2);
+
+    /* Read continued by the next message is acknowledged */
+    uint8_t buff[3] = {};
+    struct stwi_msg read[] = {
+        {0x25, 0, 1, (uint8_t *)"\x01"},
+        {0x25, STWI_M_RD, 2, &buff[0]},
+        {0x25, STWI_M_RD | STWI_M_NOSTART, 1, &buff[2]},
+    };
+    res = stwi_transfer(&sim.bus, read, 3);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_size_t(3, res.data_size);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY("\x11\x22\x33", buff, 3);
+
+    /* NACK of an absent device */
+    struct stwi_msg absent[] = {
+        {0x30, 0, 1, (uint8_t *)"\x00"},
+        {0x25, 0, 2, (uint8_t *)"\x06\x77"},
+    };
+    res = stwi_transfer(&sim.bus, absent, 2);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_NACK, res.err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_ADDR, res.stage);
+    TEST_ASSERT_EQUAL_size_t(0, res.data_size);
+    TEST_ASSERT_EQUAL_UINT8(0x00, regs[0x06]);
+    absent[0].flags = STWI_M_IGNORE_NAK;
+    res = stwi_transfer(&sim.bus, absent, 2);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_size_t(2, res.data_size);
+    TEST_ASSERT_EQUAL_UINT8(0x77, regs[0x06]);
+
+    /* Received count is added to the length */
+    memcpy(&regs[0x08], "\x03\xA1\xA2\xA3\x00", 5);
+    uint8_t block[1 + STWI_M_RECV_LEN_MAX] = {};
+    struct stwi_msg block_read[] = {
+        {0x25, 0, 1, (uint8_t *)"\x08"},
+        {0x25, STWI_M_RD | STWI_M_RECV_LEN, 1, block},
+    };
+    res = stwi_transfer(&sim.bus, block_read, 2);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_UINT16(4, block_read[1].len);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY("\x03\xA1\xA2\xA3", block, 4);
+    TEST_ASSERT_EQUAL_UINT8(0x0C, dev.ptr);
+    /* Zero count gets NACK and ends the transfer */
+    block_read[0].buf = (uint8_t *)"\x0C";
+    block_read[1].len = 1;
+    res = stwi_transfer(&sim.bus, block_read, 2);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_SIZE, res.err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_STOP, res.stage);
+    TEST_ASSERT_EQUAL_size_t(1, res.data_size);
+    TEST_ASSERT_EQUAL_UINT16(1, block_read[1].len);
+    TEST_ASSERT_EQUAL_UINT8(0x0D, dev.ptr);
+    /* So does a count larger than the limit, no data is read */
+    regs[0x0C] = STWI_M_RECV_LEN_MAX + 1;
+    res = stwi_transfer(&sim.bus, block_read, 2);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_SIZE, res.err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_STOP, res.stage);
+    TEST_ASSERT_EQUAL_UINT16(1, block_read[1].len);
+    TEST_ASSERT_EQUAL_UINT8(STWI_M_RECV_LEN_MAX + 1, block[0]);
+    TEST_ASSERT_EQUAL_UINT8(0x0D, dev.ptr);
+    /* The bus is released after the rejected count */
+    res = stwi_transfer(&sim.bus, block_read, 1);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_UINT8(0x0C, dev.ptr);
+}
+
+#if STWI_MGR
+/* Bus manager clients */
+#define MGR_CLIENTS 4
+#define MGR_ROUNDS 100
+static struct stwi_mgr mgr;
+static atomic_uint mgr_done_calls;
+
+static void mgr_done(struct stwi_mgr_req *req)
+{
+    atomic_fetch_add(&mgr_done_calls, 1);
+}
+
+/* Write own registers as a batch and read them back in every round */
+static void *mgr_client(void *arg)
+{
+    uint8_t id = (uintptr_t)arg, data[4][2], reg = id * 4, buff[4];
+    bool ok = true;
+    for (unsigned round = 0; round < MGR_ROUNDS && ok; round++)
+    {
+        struct stwi_msg msgs[5][2];
+        struct stwi_mgr_req reqs[4] = {}, read = {};
+        for (uint8_t i = 0; i < 4; i++)
+        {
+            data[i][0] = reg + i;
+            data[i][1] = round + i;
+            msgs[i][0] = (struct stwi_msg){0x25, 0, 2, data[i]};
+            reqs[i] = (struct stwi_mgr_req){.msgs = msgs[i], .count = 1, .done = mgr_done};
+        }
+        msgs[4][0] = (struct stwi_msg){0x25, 0, 1, &reg};
+        msgs[4][1] = (struct stwi_msg){0x25, STWI_M_RD, 4, buff};
+        read = (struct stwi_mgr_req){.msgs = msgs[4], .count = 2, .done = mgr_done};
+        while (!stwi_mgr_submit(&mgr, reqs, 4)) { sched_yield(); }
+        for (uint8_t i = 0; i < 4; i++)
+        {
+            stwi_mgr_wait(&mgr, &reqs[i]);
+            ok = ok && reqs[i].res.err == STWI_ERR_OK;
+        }
+        while (!stwi_mgr_submit(&mgr, &read, 1)) { sched_yield(); }
+        stwi_mgr_wait(&mgr, &read);
+        ok = ok && read.res.err == STWI_ERR_OK && read.res.data_size == 2;
+        for (uint8_t i = 0; i < 4; i++)
+        {
+            ok = ok && buff[i] == (uint8_t)(round + i);
+        }
+    }
+    return (void *)(uintptr_t)ok;
+}
+
+static void test_mgr(void)
+{
+    uint8_t regs[4 * MGR_CLIENTS] = {};
+    struct stwi_sim sim;
+    struct stwi_sim_regs dev;
+    stwi_sim_init(&sim);
+    stwi_sim_regs_init(&dev, 0x25, STWI_REG_8, regs, sizeof(regs));
+    stwi_sim_attach(&sim, &dev.dev);
+    struct stwi_mgr_slot slots[8];
+    TEST_ASSERT_FALSE(stwi_mgr_start(&mgr, &sim.bus, slots, 6));
+    TEST_ASSERT_TRUE(stwi_mgr_start(&mgr, &sim.bus, slots, 8));
+    atomic_store(&mgr_done_calls, 0);
+
+    /* Batch larger than the ring is rejected */
+    struct stwi_mgr_req reqs[9] = {};
+    TEST_ASSERT_FALSE(stwi_mgr_submit(&mgr, reqs, 9));
+
+    /* Clients share the bus */
+    pthread_t clients[MGR_CLIENTS];
+    for (uintptr_t i = 0; i < MGR_CLIENTS; i++)
+    {
+        TEST_ASSERT_EQUAL_INT(0, pthread_create(&clients[i], NULL, mgr_client, (void *)i));
+    }
+    for (size_t i = 0; i < MGR_CLIENTS; i++)
+    {
+        void *ok;
+        pthread_join(clients[i], &ok);
+        TEST_ASSERT_TRUE(ok);
+    }
+    TEST_ASSERT_EQUAL_UINT32(MGR_CLIENTS * MGR_ROUNDS * 5, atomic_load(&mgr_done_calls));
+    for (uint8_t i = 0; i < sizeof(regs); i++)
+    {
+        TEST_ASSERT_EQUAL_UINT8((uint8_t)(MGR_ROUNDS - 1 + i % 4), regs[i]);
+    }
+
+    /* Submitted requests are performed before the worker stops */
+    struct stwi_msg msg = {0x30, 0, 0, NULL};
+    struct stwi_mgr_req absent = {.msgs = &msg, .count = 1};
+    TEST_ASSERT_TRUE(stwi_mgr_submit(&mgr, &absent, 1));
+    stwi_mgr_stop(&mgr);
+    TEST_ASSERT_TRUE(stwi_mgr_done(&absent));
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_NACK, absent.res.err);
+    TEST_ASSERT_EQUAL_INT(STWI_STAGE_ADDR, absent.res.stage);
+}
+#endif
+
+/* Calibrated delay on a counter advanced by the callbacks, pin writes are slower than reads */
+static struct stwi_delay_cal cal;
+static uint32_t cal_time, cal_edges, cal_first, cal_last;
+/* A device acknowledges every byte */
+static bool cal_ack;
+
+static uint32_t cal_ticks(struct stwi_delay_cal const *cal)
+{
+    return cal_time++;
+}
+
+static void cal_write_scl(struct stwi const *bus, stwi_pin_state_t state)
+{
+    cal_time += 7;
+    if (state == STWI_PIN_HIGH)
+    {
+        if (!cal_edges++) { cal_first = cal_time; }
+        cal_last = cal_time;
+    }
+}
+
+static void cal_write_sda(struct stwi const *bus, stwi_pin_state_t state)
+{
+    cal_time += 7;
+}
+
+static stwi_pin_state_t cal_read_scl(struct stwi const *bus)
+{
+    cal_time += 3;
+    return STWI_PIN_HIGH;
+}
+
+static stwi_pin_state_t cal_read_sda(struct stwi const *bus)
+{
+    cal_time += 3;
+    return cal_ack ? STWI_PIN_LOW : STWI_PIN_HIGH;
+}
+
+static void cal_delay(struct stwi const *bus)
+{
+    stwi_delay_cal_wait(&cal, 1);
+}
+
+static void cal_delay_n(struct stwi const *bus, unsigned n)
+{
+    stwi_delay_cal_wait(&cal, n);
+}
+
+static struct stwi const stwi_cal = {
+    .write_scl = cal_write_scl,
+    .write_sda = cal_write_sda,
+    .read_scl = cal_read_scl,
+    .read_sda = cal_read_sda,
+    .delay = cal_delay,
+    .timeout_start = timeout_start,
+    .timeout_check = timeout_check,
+    .delay_n = cal_delay_n,
+};
+
+/* Get average clock period of sending bytes */
+static uint32_t cal_period(void)
+{
+    stwi_start(&stwi_cal);
+    cal_edges = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        stwi_write_byte(&stwi_cal, 0x55);
+    }
+    uint32_t period = (cal_last - cal_first) / (cal_edges - 1);
+    stwi_stop(&stwi_cal);
+    return period;
+}
+
+static void test_delay(void)
+{
+    stwi_delay_cal_init(&cal, cal_ticks, 50);
+    /* Without compensation the clock is slower */
+    TEST_ASSERT_GREATER_THAN(220, cal_period());
+    /* Compensated clock matches the configured one, every probe is start condition, address
+     * and stop condition */
+    cal_edges = 0;
+    TEST_ASSERT_GREATER_THAN(0, stwi_delay_calibrate(&cal, &stwi_cal, 0x7F));
+    TEST_ASSERT_EQUAL_UINT32(STWI_DELAY_CAL_PROBES * 11, cal_edges);
+    TEST_ASSERT_UINT32_WITHIN(4, 200, cal_period());
+    /* Probes acknowledged by a device are stopped after the address and discarded */
+    uint32_t overhead = cal.overhead;
+    cal_ack = true;
+    cal_edges = 0;
+    TEST_ASSERT_EQUAL_UINT32(0, stwi_delay_calibrate(&cal, &stwi_cal, 0x7F));
+    TEST_ASSERT_EQUAL_UINT32(STWI_DELAY_CAL_PROBES * 11, cal_edges);
+    cal_ack = false;
+    TEST_ASSERT_EQUAL_UINT32(overhead, stwi_delay_calibrate(&cal, &stwi_cal, 0x7F));
+    /* Overhead longer than the wait is not compensated */
+    stwi_delay_cal_init(&cal, cal_ticks, 2);
+    stwi_delay_calibrate(&cal, &stwi_cal, 0x7F);
+    TEST_ASSERT_GREATER_THAN(8, cal_period());
+}
+
+static void test_sim_recover(void)
+{
+    uint8_t regs[4] = {0x00, 0x12, 0x34, 0x56};
+    struct stwi_sim sim;
+    struct stwi_sim_regs sensor;
+    struct stwi_stats stats = {};
+    stwi_sim_init(&sim);
+    sim.bus.recover = true;
+    sim.bus.stats = &stats;
+    stwi_sim_regs_init(&sensor, 0x25, STWI_REG_8, regs, sizeof(regs));
+    stwi_sim_attach(&sim, &sensor.dev);
+
+    /* The master is reset in the middle of a byte sent by the device */
+    stwi_pin_state_t bit;
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, stwi_start(&sim.bus));
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, stwi_write_byte(&sim.bus, 0x25 << 1 | 0x01));
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, stwi_read_bit(&sim.bus, &bit));
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, stwi_read_bit(&sim.bus, &bit));
+    TEST_ASSERT_EQUAL_INT(STWI_PIN_LOW, sim.sda);
+
+    /* The next operation recovers the bus first */
+    uint8_t buff[3] = {};
+    struct stwi_res res = stwi_dev_read(&sim.bus, 0x25, STWI_REG_8, 0x01, buff, 3);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(&regs[1], buff, 3);
+    TEST_ASSERT_EQUAL_UINT32(STWI_STATS ? 1 : 0, stats.recoveries);
+    res = stwi_dev_read(&sim.bus, 0x25, STWI_REG_8, 0x01, buff, 3);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_UINT32(STWI_STATS ? 1 : 0, stats.recoveries);
+
+    /* Lines left low by the master itself don't need recovery */
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, stwi_start(&sim.bus));
+    TEST_ASSERT_EQUAL_INT(STWI_PIN_LOW, sim.scl);
+    res = stwi_dev_read(&sim.bus, 0x25, STWI_REG_8, 0x01, buff, 3);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(&regs[1], buff, 3);
+    TEST_ASSERT_EQUAL_UINT32(STWI_STATS ? 1 : 0, stats.recoveries);
+
+    /* Clock stretch timeout */
+    sensor.dev.stretch_byte = 10;
+    sim.stretch_timeout = 5;
+    res = stwi_dev_read(&sim.bus, 0x25, STWI_REG_8, 0x01, buff, 3);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_STRETCH, res.err);
+    TEST_ASSERT_EQUAL_UINT32(STWI_STATS ? 2 : 0, stats.recoveries);
+    sensor.dev.stretch_byte = 0;
+    res = stwi_dev_read(&sim.bus, 0x25, STWI_REG_8, 0x01, buff, 3);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(&regs[1], buff, 3);
+}
+
+/* Trace sinks */
+struct trace_sinks
+{
+    struct stwi_trace_vcd vcd;
+    struct stwi_trace_log log;
+    size_t calls;
+};
+
+static void trace_sink(struct stwi_trace *trace, struct stwi_trace_event const *events, size_t count)
+{
+    struct trace_sinks *sinks = trace->ctx;
+    sinks->calls++;
+    stwi_trace_vcd_write(&sinks->vcd, events, count);
+    stwi_trace_log_write(&sinks->log, events, count);
+}
+
+static void test_trace(void)
+{
+    static char vcd[20000], log[1000];
+    uint8_t regs[4] = {};
+    struct stwi_sim sim;
+    struct stwi_sim_regs sensor;
+    stwi_sim_init(&sim);
+    stwi_sim_regs_init(&sensor, 0x25, STWI_REG_8, regs, sizeof(regs));
+    stwi_sim_attach(&sim, &sensor.dev);
+
+    struct stwi_trace_event events[8];
+    struct stwi_trace trace;
+    struct trace_sinks sinks = {
+        .vcd = {.file = fmemopen(vcd, sizeof(vcd), "w")},
+        .log = {.file = fmemopen(log, sizeof(log), "w")},
+    };
+    stwi_trace_init(&trace, &sim.bus, events, 8, trace_sink, &sinks);
+    struct stwi_res res = stwi_dev_write(&trace.bus, 0x25, STWI_REG_8, 0x02, (uint8_t *)"\x12\x34", 2);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_OK, res.err);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY("\x00\x00\x12\x34", regs, 4);
+    uint8_t buff[2] = {};
+    res = stwi_dev_read(&trace.bus, 0x26, STWI_REG_0, 0x00, buff, 2);
+    TEST_ASSERT_EQUAL_INT(STWI_ERR_NACK, res.err);
+    stwi_trace_flush(&trace);
+    fclose(sinks.vcd.file);
+    fclose(sinks.log.file);
+    /* The buffer has been drained many times */
+    TEST_ASSERT_GREATER_THAN(10, sinks.calls);
+    TEST_ASSERT_EQUAL_STRING("2 START\n"
+                             "5 ADDR 0x25 W ACK\n"
+                             "41 DATA 0x02 ACK\n"
+                             "77 DATA 0x12 ACK\n"
+                             "113 DATA 0x34 ACK\n"
+                             "150 STOP\n"
+                             "153 START\n"
+                             "156 ADDR 0x26 W NACK\n",
+                             log);
+    TEST_ASSERT_EQUAL_MEMORY("$timescale 1 us $end\n"
+                             "$scope module stwi $end\n"
+                             "$var wire 1 c scl $end\n"
+                             "$var wire 1 d sda $end\n"
+                             "$upscope $end\n"
+                             "$enddefinitions $end\n"
+                             "#0\n1c\n1d\n"
+                             "#2\n0d\n"
+                             "#3\n0c\n"
+                             "#5\n1c\n",
+                             vcd, 153);
+}
+/*------------------------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------------------------*/
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_start);
+    RUN_TEST(test_start_stretch);
+    RUN_TEST(test_start_stretch_backoff);
+    RUN_TEST(test_start_stretch_timeout);
+    RUN_TEST(test_repeated_start);
+    RUN_TEST(test_stop);
+    RUN_TEST(test_stop_stretch);
+    RUN_TEST(test_recover);
+    RUN_TEST(test_recover_err);
+    RUN_TEST(test_read_byte_ack);
+    RUN_TEST(test_read_byte_nack);
+    RUN_TEST(test_read_byte_stretch);
+    RUN_TEST(test_write_byte_ack);
+    RUN_TEST(test_write_byte_nack);
+    RUN_TEST(test_write_byte_stretch);
+    RUN_TEST(test_write_2bytes);
+    RUN_TEST(test_read_2bytes);
+    RUN_TEST(test_dev_write_reg16);
+    RUN_TEST(test_dev_write_reg8);
+    RUN_TEST(test_dev_write_reg0);
+    RUN_TEST(test_dev_write_err_start);
+    RUN_TEST(test_dev_write_err_addr);
+    RUN_TEST(test_dev_write_err_reg);
+    RUN_TEST(test_dev_write_err_data);
+    RUN_TEST(test_dev_write_err_stop);
+    RUN_TEST(test_dev_read_reg16);
+    RUN_TEST(test_dev_read_reg8);
+    RUN_TEST(test_dev_read_reg0);
+    RUN_TEST(test_dev_read_err_start);
+    RUN_TEST(test_dev_read_err_addr);
+    RUN_TEST(test_dev_read_err_reg);
+    RUN_TEST(test_dev_read_err_rep_start);
+    RUN_TEST(test_dev_read_err_rep_addr);
+    RUN_TEST(test_dev_read_err_data);
+    RUN_TEST(test_dev_read_err_stop);
+    RUN_TEST(test_multi_dev_write);
+    RUN_TEST(test_multi_dev_read);
+    RUN_TEST(test_multi_dev_read_stretch);
+    RUN_TEST(test_lines_dev_write);
+    RUN_TEST(test_hpp_dev_write);
+    RUN_TEST(test_hpp_dev_read);
+    RUN_TEST(test_hpp_dev_read_stretch);
+    RUN_TEST(test_hpp_nostretch);
+    RUN_TEST(test_lines_read_byte_stretch);
+    RUN_TEST(test_lines_read);
+    RUN_TEST(test_wave_write);
+    RUN_TEST(test_wave_write_err_data);
+    RUN_TEST(test_wave_read);
+    RUN_TEST(test_wave_read_err_addr);
+    RUN_TEST(test_xfer_write);
+    RUN_TEST(test_xfer_write_err_addr);
+    RUN_TEST(test_xfer_write_err_stop);
+    RUN_TEST(test_xfer_read);
+    RUN_TEST(test_xfer_read_stretch);
+    RUN_TEST(test_xfer_read_err_data);
+    RUN_TEST(test_batch);
+    RUN_TEST(test_batch_err);
+    RUN_TEST(test_dev_writev);
+    RUN_TEST(test_dev_readv);
+    RUN_TEST(test_eeprom_write);
+    RUN_TEST(test_eeprom_init);
+    RUN_TEST(test_eeprom_write_err_poll);
+    RUN_TEST(test_regmap_read);
+    RUN_TEST(test_regmap_write);
+    RUN_TEST(test_timing_write_byte);
+    RUN_TEST(test_timing_lines_read_byte);
+    RUN_TEST(test_sim_eeprom);
+    RUN_TEST(test_sim_regs_stretch);
+    RUN_TEST(test_scan);
+    RUN_TEST(test_speed);
+#if STWI_STATS
+    RUN_TEST(test_stats);
+#else
+    RUN_TEST(test_stats_disabled);
+#endif
+    RUN_TEST(test_sched);
+    RUN_TEST(test_stream);
+    RUN_TEST(test_smbus);
+    RUN_TEST(test_transfer);
+#if STWI_MGR
+    RUN_TEST(test_mgr);
+#endif
+    RUN_TEST(test_delay);
+    RUN_TEST(test_sim_recover);
+    RUN_TEST(test_trace);
     return UNITY_END();
 }
 /*------------------------------------------------------------------------------------------------*/
\ No newline at end of file
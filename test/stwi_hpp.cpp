@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2020 Oleg Dolgy
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Instantiation of the C++ front end for the tests: pin, delay and timeout policies forward
+ * to the callbacks of a C bus handle, so the waveforms can be compared with the C functions.
+ *
+ */
+
+#include "stwi.hpp"
+
+/* Bus handle the policies forward to */
+static struct stwi const *hpp_bus;
+
+struct hpp_pins
+{
+    static void write_scl(stwi_pin_state_t state) { hpp_bus->write_scl(hpp_bus, state); }
+    static void write_sda(stwi_pin_state_t state) { hpp_bus->write_sda(hpp_bus, state); }
+    static stwi_pin_state_t read_scl() { return hpp_bus->read_scl(hpp_bus); }
+    static stwi_pin_state_t read_sda() { return hpp_bus->read_sda(hpp_bus); }
+};
+
+struct hpp_delay
+{
+    static void delay() { hpp_bus->delay(hpp_bus); }
+};
+
+struct hpp_timeout
+{
+    static void start() { hpp_bus->timeout_start(hpp_bus); }
+    static bool check() { return hpp_bus->timeout_check(hpp_bus); }
+};
+
+/* Pins without clock stretching: no SCL input and no timeout are needed */
+struct hpp_pins_nostretch
+{
+    static constexpr bool stretch = false;
+    static void write_scl(stwi_pin_state_t state) { hpp_bus->write_scl(hpp_bus, state); }
+    static void write_sda(stwi_pin_state_t state) { hpp_bus->write_sda(hpp_bus, state); }
+    static stwi_pin_state_t read_sda() { return hpp_bus->read_sda(hpp_bus); }
+};
+
+struct hpp_no_timeout
+{
+};
+
+using hpp = softbus::stwi_bus<hpp_pins, hpp_delay, hpp_timeout>;
+using hpp_nostretch = softbus::stwi_bus<hpp_pins_nostretch, hpp_delay, hpp_no_timeout>;
+static_assert(hpp::stretch && !hpp_nostretch::stretch);
+
+extern "C" struct stwi_res hpp_dev_write(struct stwi const *bus,
+                                          uint8_t addr,
+                                          stwi_reg_size_t reg_size,
+                                          uint16_t reg,
+                                          uint8_t const *buff,
+                                          size_t size)
+{
+    hpp_bus = bus;
+    return hpp::dev_write(addr, reg_size, reg, std::span<uint8_t const>(buff, size));
+}
+
+extern "C" struct stwi_res hpp_dev_read(struct stwi const *bus,
+                                         uint8_t addr,
+                                         stwi_reg_size_t reg_size,
+                                         uint16_t reg,
+                                         uint8_t *buff,
+                                         size_t size)
+{
+    hpp_bus = bus;
+    return hpp::dev_read(addr, reg_size, reg, std::span<uint8_t>(buff, size));
+}
+
+extern "C" struct stwi_res hpp_nostretch_dev_write(struct stwi const *bus,
+                                                    uint8_t addr,
+                                                    stwi_reg_size_t reg_size,
+                                                    uint16_t reg,
+                                                    uint8_t const *buff,
+                                                    size_t size)
+{
+    hpp_bus = bus;
+    return hpp_nostretch::dev_write(addr, reg_size, reg, std::span<uint8_t const>(buff, size));
+}
+
+extern "C" struct stwi_res hpp_nostretch_dev_read(struct stwi const *bus,
+                                                   uint8_t addr,
+                                                   stwi_reg_size_t reg_size,
+                                                   uint16_t reg,
+                                                   uint8_t *buff,
+                                                   size_t size)
+{
+    hpp_bus = bus;
+    return hpp_nostretch::dev_read(addr, reg_size, reg, std::span<uint8_t>(buff, size));
+}